@@ -1,5 +1,8 @@
 #include <stdio.h> // For printf (for demonstration purposes, replace with actual UART/LCD output)
 #include <string.h> // For strcpy
+#include <stdint.h> // For fixed-width trunk/cost fields
+#include <stdbool.h> // For true/false
+#include <stdatomic.h> // For lock-free rate table swaps and trunk bitmaps
 
 // Define the maximum number of speed dial entries
 #define MAX_SPEED_DIALS 10
@@ -12,6 +15,48 @@ typedef struct {
     char contactName[20]; // Optional: to store a name
 } SpeedDialEntry;
 
+// --- Least-cost trunk selection ---
+
+// Define the number of outgoing trunks (one bit each in the availability bitmap)
+#define MAX_TRUNKS 32
+// Define the maximum number of distinct destination prefixes in a rate table
+#define MAX_RATE_PREFIXES 64
+// Define the maximum number of candidate trunks per prefix
+#define MAX_ROUTES_PER_PREFIX 4
+// Define the maximum number of digit trie nodes in a rate table
+#define MAX_RATE_TRIE_NODES 256
+
+// A candidate trunk for a prefix and its cost (in tenths of a cent per minute)
+typedef struct {
+    uint8_t trunk;
+    uint16_t costPerMinute;
+} TrunkRoute;
+
+// A node of the digit trie used for longest-prefix matching
+typedef struct {
+    int16_t child[10]; // Index of the child node for each digit, or -1
+    int8_t routeList;  // Index into RateTable.routes if a prefix ends here, or -1
+} RateTrieNode;
+
+/**
+ * @brief A complete rate table: prefix trie plus a cost-ordered trunk list per prefix.
+ * Two tables exist so a new one can be loaded while dials keep using the active one.
+ */
+typedef struct {
+    RateTrieNode nodes[MAX_RATE_TRIE_NODES];
+    int nodeCount;
+    TrunkRoute routes[MAX_RATE_PREFIXES][MAX_ROUTES_PER_PREFIX];
+    uint8_t routeCount[MAX_RATE_PREFIXES];
+    int prefixCount;
+    atomic_int readers; // Dials currently reading this table
+} RateTable;
+
+RateTable rateTables[2];
+// The table consulted by dialSpeedDial (NULL until the first reload is committed)
+_Atomic(RateTable *) activeRateTable = NULL;
+// Bit n set means trunk n is currently available
+atomic_uint_least32_t trunkAvailability = 0;
+
 // Array to store speed dial entries
 // Initialize with empty strings or default values
 SpeedDialEntry speedDialList[MAX_SPEED_DIALS] = {0};
@@ -81,15 +126,177 @@ const char* getSpeedDialNumber(int index) {
     return speedDialList[index].phoneNumber;
 }
 
+/**
+ * @brief Marks a trunk as available or unavailable for outgoing calls.
+ * Safe to call at any time, including while dials are in progress.
+ * @param trunk The trunk index (0 to MAX_TRUNKS - 1).
+ * @param available true if the trunk can carry calls.
+ */
+void setTrunkAvailable(int trunk, bool available) {
+    if (trunk < 0 || trunk >= MAX_TRUNKS) {
+        printf("Error: Invalid trunk %d. Must be between 0 and %d.\n", trunk, MAX_TRUNKS - 1);
+        return;
+    }
+    if (available) {
+        atomic_fetch_or(&trunkAvailability, (uint_least32_t)1 << trunk);
+    } else {
+        atomic_fetch_and(&trunkAvailability, ~((uint_least32_t)1 << trunk));
+    }
+}
+
+/**
+ * @brief Starts loading a new rate table into the inactive buffer.
+ * Waits only for dials still reading the previous generation of that buffer;
+ * dials themselves never wait. Only one reload may be in progress at a time.
+ * @return The empty table to fill with addRate() and then pass to commitRateTableReload().
+ */
+RateTable* beginRateTableReload() {
+    RateTable *table = (atomic_load(&activeRateTable) == &rateTables[0]) ? &rateTables[1] : &rateTables[0];
+    while (atomic_load(&table->readers) != 0) {
+        // A dial that started before the last swap is still walking this table
+    }
+    memset(table->nodes, 0xFF, sizeof(table->nodes)); // All children and route lists become -1
+    table->nodeCount = 1; // Node 0 is the root (the empty prefix)
+    table->prefixCount = 0;
+    return table;
+}
+
+/**
+ * @brief Adds a trunk and its cost for a destination prefix to a table being loaded.
+ * Routes for the same prefix are kept ordered from cheapest to most expensive.
+ * @param table The table returned by beginRateTableReload().
+ * @param prefix The destination prefix digits (e.g., "555"); "" matches every number.
+ * @param trunk The trunk index (0 to MAX_TRUNKS - 1).
+ * @param costPerMinute The cost of this trunk for the prefix, in tenths of a cent per minute.
+ * @return 0 on success, -1 on failure (invalid prefix or trunk, or the table is full).
+ */
+int addRate(RateTable *table, const char *prefix, int trunk, uint16_t costPerMinute) {
+    if (trunk < 0 || trunk >= MAX_TRUNKS) {
+        printf("Error: Invalid trunk %d for prefix '%s'.\n", trunk, prefix);
+        return -1;
+    }
+
+    int node = 0;
+    for (const char *p = prefix; *p != '\0'; p++) {
+        if (*p < '0' || *p > '9') {
+            printf("Error: Rate prefix '%s' must contain only digits.\n", prefix);
+            return -1;
+        }
+        int digit = *p - '0';
+        if (table->nodes[node].child[digit] < 0) {
+            if (table->nodeCount >= MAX_RATE_TRIE_NODES) {
+                printf("Error: Rate table is full. Cannot add prefix '%s'.\n", prefix);
+                return -1;
+            }
+            table->nodes[node].child[digit] = (int16_t)table->nodeCount++;
+        }
+        node = table->nodes[node].child[digit];
+    }
+
+    if (table->nodes[node].routeList < 0) {
+        if (table->prefixCount >= MAX_RATE_PREFIXES) {
+            printf("Error: Rate table has too many prefixes. Cannot add prefix '%s'.\n", prefix);
+            return -1;
+        }
+        table->nodes[node].routeList = (int8_t)table->prefixCount;
+        table->routeCount[table->prefixCount++] = 0;
+    }
+
+    int list = table->nodes[node].routeList;
+    int count = table->routeCount[list];
+    if (count >= MAX_ROUTES_PER_PREFIX) {
+        printf("Error: Prefix '%s' already has %d trunks.\n", prefix, MAX_ROUTES_PER_PREFIX);
+        return -1;
+    }
+
+    // Insertion keeps the cheapest trunk first, so dialing takes the first available one
+    int pos = count;
+    while (pos > 0 && table->routes[list][pos - 1].costPerMinute > costPerMinute) {
+        table->routes[list][pos] = table->routes[list][pos - 1];
+        pos--;
+    }
+    table->routes[list][pos].trunk = (uint8_t)trunk;
+    table->routes[list][pos].costPerMinute = costPerMinute;
+    table->routeCount[list]++;
+    return 0;
+}
+
+/**
+ * @brief Makes a fully loaded table the one used by subsequent dials.
+ * @param table The table returned by beginRateTableReload().
+ */
+void commitRateTableReload(RateTable *table) {
+    atomic_store(&activeRateTable, table);
+    printf("Rate table loaded: %d prefixes.\n", table->prefixCount);
+}
+
+/**
+ * @brief Picks the cheapest available trunk for a number using the longest matching prefix.
+ * Non-digit characters in the number (e.g., '-') are skipped. This is a bounded walk
+ * of at most one trie node per digit and never blocks.
+ * @param number The phone number to route.
+ * @return The trunk index, or -1 if no rate table is loaded, no prefix matches,
+ * or every trunk for the matching prefix is unavailable.
+ */
+int selectTrunk(const char *number) {
+    RateTable *table;
+    for (;;) {
+        table = atomic_load(&activeRateTable);
+        if (table == NULL) {
+            return -1;
+        }
+        atomic_fetch_add(&table->readers, 1);
+        if (atomic_load(&activeRateTable) == table) {
+            break;
+        }
+        atomic_fetch_sub(&table->readers, 1); // Swapped underneath us, retry with the new table
+    }
+
+    int node = 0;
+    int list = table->nodes[0].routeList;
+    for (const char *p = number; *p != '\0'; p++) {
+        if (*p < '0' || *p > '9') {
+            continue;
+        }
+        node = table->nodes[node].child[*p - '0'];
+        if (node < 0) {
+            break;
+        }
+        if (table->nodes[node].routeList >= 0) {
+            list = table->nodes[node].routeList;
+        }
+    }
+
+    int trunk = -1;
+    if (list >= 0) {
+        uint_least32_t available = atomic_load(&trunkAvailability);
+        for (int i = 0; i < table->routeCount[list]; i++) {
+            if (available & ((uint_least32_t)1 << table->routes[list][i].trunk)) {
+                trunk = table->routes[list][i].trunk;
+                break;
+            }
+        }
+    }
+
+    atomic_fetch_sub(&table->readers, 1);
+    return trunk;
+}
+
 /**
  * @brief "Dials" the number associated with the given speed dial index.
  * In a real microcontroller, this would involve sending commands to a GSM/LTE module.
+ * The call is placed on the cheapest available trunk for the number's prefix.
  * @param index The speed dial index to dial.
  */
 void dialSpeedDial(int index) {
     const char* numberToDial = getSpeedDialNumber(index);
     if (numberToDial != NULL) {
-        printf("Attempting to dial: %s (from speed dial %d - %s)\n", numberToDial, index, speedDialList[index].contactName);
+        int trunk = selectTrunk(numberToDial);
+        if (trunk < 0) {
+            printf("Cannot dial %s. No trunk available for this destination.\n", numberToDial);
+            return;
+        }
+        printf("Attempting to dial: %s via trunk %d (from speed dial %d - %s)\n", numberToDial, trunk, index, speedDialList[index].contactName);
         // --- Microcontroller specific code would go here ---
         // Example: sendATCommand("ATD%s;\r\n", numberToDial);
         // Or trigger a function to control a communication module
@@ -106,6 +313,17 @@ void dialSpeedDial(int index) {
 int main() {
     initializeSpeedDial();
 
+    // Load a rate table: trunk 1 is cheapest for "555", trunk 2 is the fallback,
+    // and trunk 0 carries everything else.
+    RateTable *rates = beginRateTableReload();
+    addRate(rates, "", 0, 50);
+    addRate(rates, "555", 2, 30);
+    addRate(rates, "555", 1, 10);
+    commitRateTableReload(rates);
+    setTrunkAvailable(0, true);
+    setTrunkAvailable(1, true);
+    setTrunkAvailable(2, true);
+
     printf("\n--- Demonstrating Speed Dial ---\n");
 
     // Simulate user input or events
@@ -124,6 +342,10 @@ int main() {
     printf("\nSimulating dialing newly assigned speed dial 5...\n");
     dialSpeedDial(5);
 
+    printf("\nSimulating dialing speed dial 2 (Work) with its cheapest trunk down...\n");
+    setTrunkAvailable(1, false);
+    dialSpeedDial(2); // Should fall back to trunk 2
+
     printf("\n--- End of Demonstration ---\n");
 
     return 0;
@@ -1,19 +1,196 @@
+#define _GNU_SOURCE // For MAP_POPULATE and other Linux extensions
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h> // For true/false
+#include <stdint.h>
+#include <time.h>     // For clock_gettime in benchmarks
+#include <fcntl.h>    // For open
+#include <unistd.h>   // For close
+#include <sys/mman.h> // For mmap
+#include <sys/stat.h> // For fstat
+#include <pthread.h>  // For parallel bulk operations
+#include <stdatomic.h>
+#include <stddef.h>   // For offsetof
+#include <stdarg.h>   // For formatted protocol lines
+#include <poll.h>     // For the lookup server event loop
+#include <sys/socket.h>
+#include <sys/un.h>   // For the local socket protocol
+#include <errno.h>    // For non-blocking server sockets
+#include <netinet/in.h> // For the metrics endpoint
+#include <sched.h>    // For sched_getcpu
+#if defined(__has_include) && !defined(SPEEDDIAL_NO_USDT)
+#if __has_include(<sys/sdt.h>)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h> // For USDT probes (systemtap-sdt-dev); see "Static Tracepoints"
+#define SPEEDDIAL_USDT
+#endif
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h> // For 16-byte field comparisons
+#endif
+#ifdef __GLIBC__
+#include <malloc.h> // For malloc_usable_size in the directory memory report
+#endif
 
 // --- Constants ---
+// Sizes marked "configurable" can be overridden with -D. SPEEDDIAL_COMPACT selects a
+// profile for microcontrollers: every table is statically allocated (no malloc in
+// initializeSpeedDialManager()), fields are narrowed to what short codes and national
+// numbers need, and the auxiliary tables shrink. printFootprintReport() lists the result.
+#ifdef SPEEDDIAL_COMPACT
+#define SPEEDDIAL_STATIC_STORAGE
+#define MAX_CODE_LENGTH 16     // Codes up to 15 characters
+#define MAX_PHONE_LENGTH 16    // Numbers up to 15 characters
+#define MAX_DIR_NAME_LENGTH 16
+#define SCAN_NUMBER_WIDTH 16
+#define PREFIX_STATS_DEPTH 2
+#define CALL_LOG_CAPACITY 256
+#define LOOKUP_CACHE_SIZE 16
+#define CHANGE_FEED_CAPACITY 32
+#define RATE_LIMIT_SHARDS 1
+#define MAX_EMERGENCY_ENTRIES 2
+#define DIAL_COUNT_BITS 8
+#endif
+
 #define MAX_DIRECTORIES 5
-#define TOTAL_NUMBERS 1000
+#ifndef TOTAL_NUMBERS
+#define TOTAL_NUMBERS 1000 // Configurable (keep it a multiple of MAX_DIRECTORIES)
+#endif
 #define MAX_NUMBERS_PER_DIRECTORY (TOTAL_NUMBERS / MAX_DIRECTORIES) // 200 numbers per directory
 
+#ifndef MAX_CODE_LENGTH
 #define MAX_CODE_LENGTH 50    // Max length for speed dial code (e.g., "home", "work")
+#endif
+#ifndef MAX_PHONE_LENGTH
 #define MAX_PHONE_LENGTH 20   // Max length for phone number (e.g., "123-456-7890")
+#endif
+#ifndef MAX_DIR_NAME_LENGTH
 #define MAX_DIR_NAME_LENGTH 50 // Max length for directory name (e.g., "Directory 1")
+#endif
+
+// Number portability records pack a phone number (up to 15 digits) above a carrier id.
+#define PORTABILITY_CARRIER_BITS 14
+#define PORTABILITY_NO_CARRIER ((1u << PORTABILITY_CARRIER_BITS) - 1) // Reserved: "not ported"
+#define PORTABILITY_MAX_INTERPOLATION_PROBES 4 // Give up on interpolation after this many probes
+#define PORTABILITY_BINARY_CUTOFF 64           // Ranges this small go straight to binary search
+
+#ifndef OWNER_INDEX_BITS
+#define OWNER_INDEX_BITS 11 // 2048 slots: at most half full with TOTAL_NUMBERS entries (configurable)
+#endif
+#define OWNER_INDEX_SIZE (1 << OWNER_INDEX_BITS)
+// buildOwnerIndex() probes until it finds a free slot, so there must always be one
+_Static_assert(OWNER_INDEX_SIZE >= 2 * TOTAL_NUMBERS, "OWNER_INDEX_BITS too small for TOTAL_NUMBERS");
+#define MAX_JOIN_THREADS 16
+
+#ifndef SET_PROBE_BITS
+#define SET_PROBE_BITS 9 // 512 slots: at most ~40% full with MAX_NUMBERS_PER_DIRECTORY entries (configurable)
+#endif
+#define SET_PROBE_SIZE (1 << SET_PROBE_BITS)
+// buildSetProbe() probes until it finds a free slot and stores entry index + 1 in 16 bits
+_Static_assert(SET_PROBE_SIZE >= 2 * MAX_NUMBERS_PER_DIRECTORY, "SET_PROBE_BITS too small for MAX_NUMBERS_PER_DIRECTORY");
+_Static_assert(MAX_NUMBERS_PER_DIRECTORY < UINT16_MAX, "Set probe keys are 16 bits");
+
+#define RADIX_INSERTION_CUTOFF 32 // Buckets smaller than this are finished with insertion sort
+#define MAX_SORT_THREADS 16
+
+#define SHORT_KEY_LENGTH 16                     // Codes up to this long are compared as two 64-bit words
+#define SCAN_CODE_PREFIX_WIDTH SHORT_KEY_LENGTH // Leading code bytes kept in the scan columns (the short keys)
+// Bytes makeShortKey() reads: one past a short key tells longer codes apart, unless no stored code can be longer
+#define SHORT_KEY_SCAN_LENGTH (MAX_CODE_LENGTH <= SHORT_KEY_LENGTH ? SHORT_KEY_LENGTH : SHORT_KEY_LENGTH + 1)
+#ifndef SCAN_NUMBER_WIDTH
+#define SCAN_NUMBER_WIDTH 32      // Phone numbers are kept whole (a multiple of 16 of at least MAX_PHONE_LENGTH)
+#endif
+
+#ifndef PREFIX_STATS_DEPTH
+#define PREFIX_STATS_DEPTH 4 // Numbers are counted under their first 1..4 digits (country/area code)
+#endif
+#if PREFIX_STATS_DEPTH < 1 || PREFIX_STATS_DEPTH > 4
+#error "PREFIX_STATS_DEPTH must be 1..4"
+#endif
+// One counter per possible prefix: the empty one, then 10^k prefixes of each length k
+#define PREFIX_STATS_COUNTERS \
+    (PREFIX_STATS_DEPTH == 1 ? 11 : PREFIX_STATS_DEPTH == 2 ? 111 : PREFIX_STATS_DEPTH == 3 ? 1111 : 11111)
+
+#ifndef CALL_LOG_CAPACITY
+#define CALL_LOG_CAPACITY 4096      // Records kept before the oldest is overwritten (power of two, configurable)
+#endif
+#define CALL_LOG_MAGIC 0x53444C33u  // "SDL3": marks an initialized call log file (28-byte records)
+
+#ifndef LOOKUP_CACHE_SIZE
+#define LOOKUP_CACHE_SIZE 64 // Direct-mapped getPhoneNumber() cache slots (power of two, configurable)
+#endif
+#define HOURS_PER_DAY 24
+#ifndef DIAL_COUNT_BITS
+#define DIAL_COUNT_BITS 16 // Width of the learned per-hour dial counters (8 or 16, configurable)
+#endif
+
+#ifndef CHANGE_FEED_CAPACITY
+#define CHANGE_FEED_CAPACITY 1024 // Recent change events kept in memory (power of two, configurable)
+#endif
+// Entries one transaction may move: its events (two per entry) must fit in the in-memory feed
+#define MAX_TRANSACTION_MOVES \
+    (CHANGE_FEED_CAPACITY / 2 < MAX_NUMBERS_PER_DIRECTORY ? CHANGE_FEED_CAPACITY / 2 : MAX_NUMBERS_PER_DIRECTORY)
+
+#define MAX_SERVER_CLIENTS 32    // Concurrent connections to the lookup server
+#define SERVER_LINE_LENGTH 256   // Longest protocol line, including the newline
+#define SERVER_OUTBOX_LENGTH 8192 // Reply and INV bytes a connection may leave unread before the server holds back
+#define MAX_METRICS_CONNECTIONS 4  // Metrics scrapes served at once; more wait in the listen backlog
+#define METRICS_SCRAPE_TIMEOUT 1000000000ull // Nanoseconds a scrape may take before it is dropped
+#define CLIENT_CACHE_SIZE 256    // Direct-mapped client cache slots (power of two)
+
+#ifndef RATE_LIMIT_SHARDS
+#define RATE_LIMIT_SHARDS 8   // Per-core token bucket shards for each tenant and request class (configurable)
+#endif
+#define SHED_BULK_LOAD 64     // Requests per server loop above which bulk requests are refused
+#define SHED_EDIT_LOAD 256    // Requests per server loop above which edits are refused too
+#define LIST_LINES_PER_PASS 64 // Listing lines sent per server loop, after every other lane is drained
+// Outbox room a connection needs before its next request runs: a listing pass, or one long reply
+#define SERVER_REPLY_ROOM (LIST_LINES_PER_PASS * (MAX_CODE_LENGTH + MAX_PHONE_LENGTH + 6) + SERVER_LINE_LENGTH * 2)
+
+#ifndef MAX_EMERGENCY_ENTRIES
+#define MAX_EMERGENCY_ENTRIES 8 // Entries flagged for the pinned, lock-free dial path (configurable)
+#endif
+#define REALTIME_STACK_PREFAULT (256 * 1024) // Stack bytes touched on entering real-time mode
+
+#define TRACE_MAGIC 0x52544453u      // "SDTR": marks a trace file
+#define TRACE_BUFFER_RECORDS 512     // Records a thread collects before writing them out
+#define MAX_TRACE_THREADS 64         // Threads that can record into one trace
+#define TRACE_NO_DIRECTORY 0xFF      // Directory index recorded for an unknown directory name
+
+#define MAX_METRICS_THREADS 64 // Threads with their own metrics shard; later ones share the last
+#define LATENCY_BUCKETS 10     // Operation latency histogram buckets, the last one unbounded
+
+#define ENTRY_ID_SLOT_BITS 16 // An EntryId is (generation << 16) | slot
+// Slot numbers live in ENTRY_ID_SLOT_BITS of an id and, with entry indexes, in EntrySlot's int16_t fields
+_Static_assert(TOTAL_NUMBERS <= INT16_MAX, "TOTAL_NUMBERS too large for EntrySlot and EntryId slot fields");
+#define INVALID_ENTRY_ID 0    // Generations start at 1, so no live entry has id 0
 
 // --- Data Structures ---
 
+/**
+ * @brief A stable handle to a speed dial entry.
+ * Unlike an array position, an EntryId survives other entries being removed, and
+ * becomes stale (rather than pointing at a different entry) once its own entry is removed.
+ */
+typedef uint32_t EntryId;
+
+/**
+ * @brief A speed dial code of up to SHORT_KEY_LENGTH bytes, zero padded into two words.
+ * Two codes that fit are equal exactly when both words are.
+ */
+typedef struct {
+    uint64_t word[2];
+} ShortKey;
+
+// A learned per-hour dial count; saturates at DIAL_COUNT_MAX
+#if DIAL_COUNT_BITS == 8
+typedef uint8_t DialCount;
+#else
+typedef uint16_t DialCount;
+#endif
+#define DIAL_COUNT_MAX ((DialCount)~(DialCount)0)
+
 /**
  * @brief Represents a single speed dial entry.
  * Stores a unique speed dial code and its corresponding phone number.
@@ -21,8 +198,31 @@
 typedef struct {
     char speedDialCode[MAX_CODE_LENGTH];
     char phoneNumber[MAX_PHONE_LENGTH];
+    EntryId id; // Stable handle assigned by addNumber()
 } SpeedDialEntry;
 
+/**
+ * @brief One slot of the entry slot map: where the entry holding this slot currently lives.
+ */
+typedef struct {
+    uint16_t generation;    // Bumped each time the slot is released
+    int16_t directoryIndex; // -1 while the slot is free
+    int16_t entryIndex;     // Position in the directory; next free slot while free
+    _Atomic uint32_t version; // (entry version << 1) | 1 while an editor holds the entry
+} EntrySlot;
+
+/**
+ * @brief Column-oriented copy of a directory's entries for predicate scans.
+ * Row i describes entries[i]; text columns are zero padded so they can be
+ * compared 16 bytes at a time. Kept in step by addNumber()/removeNumber().
+ */
+typedef struct {
+    uint8_t codeLength[MAX_NUMBERS_PER_DIRECTORY];
+    uint8_t numberLength[MAX_NUMBERS_PER_DIRECTORY];
+    char codePrefix[MAX_NUMBERS_PER_DIRECTORY][SCAN_CODE_PREFIX_WIDTH];
+    char number[MAX_NUMBERS_PER_DIRECTORY][SCAN_NUMBER_WIDTH];
+} DirectoryColumns;
+
 /**
  * @brief Represents a single directory within the speed dial system.
  * Contains a name, a dynamic array of speed dial entries, and the current count of entries.
@@ -31,8 +231,64 @@ typedef struct {
     char name[MAX_DIR_NAME_LENGTH];
     SpeedDialEntry *entries; // Pointer to a dynamically allocated array of SpeedDialEntry
     int currentCount;        // Current number of entries in this directory
+    DirectoryColumns *columns; // Scan view of entries, allocated alongside them
+    int quota;                 // Planned capacity used for fill ratio (defaults to MAX_NUMBERS_PER_DIRECTORY)
 } Directory;
 
+/**
+ * @brief One slot of the number -> owner hash index (open addressing, linear probing).
+ */
+typedef struct {
+    uint64_t number; // Packed phone number; 0 marks an empty slot
+    EntryId owner;
+} OwnerIndexSlot;
+
+/**
+ * @brief Counts the numbers that start with one digit prefix, for distribution statistics.
+ * Counters are laid out by prefix length: the prefix d1..dk is at 10 * (counter of d1..dk-1) + 1 + dk,
+ * so counter 0 is the empty prefix, 1..10 the single digits, 11..110 the two-digit prefixes, and so on.
+ */
+typedef struct {
+    _Atomic uint16_t total; // Numbers with this prefix across all directories
+    _Atomic uint16_t count[MAX_DIRECTORIES];
+} PrefixCounter;
+
+/**
+ * @brief Occupancy of one directory, as reported by getDirectoryStats().
+ */
+typedef struct {
+    int count;
+    int quota;
+    double fillRatio; // count / quota
+} DirectoryStats;
+
+/**
+ * @brief Memory one directory costs, as reported by getDirectoryMemory().
+ * The parts add up to total.
+ */
+typedef struct {
+    size_t entries; // Entry records in use, less their text: ids and fixed-width field padding
+    size_t strings; // Text of the codes and numbers in use, terminators included
+    size_t indexes; // Scan column rows, owner index and slot map entries, prefix statistics counts
+    size_t caches;  // Lookup cache slots, learned dial counts and emergency copies held for the directory
+    size_t slack;   // Allocated but unused: spare capacity and allocator rounding
+    size_t total;
+} DirectoryMemory;
+
+/**
+ * @brief A pinned copy of an entry flagged for the emergency fast path.
+ * The directory and code never change once the slot is in use; the number and id
+ * are rewritten under a sequence count (odd while being written), so readers copy
+ * them without locks and retry if a copy was torn.
+ */
+typedef struct {
+    uint8_t directoryIndex;
+    char speedDialCode[MAX_CODE_LENGTH];
+    _Atomic uint32_t sequence;
+    EntryId id;                         // INVALID_ENTRY_ID while the code is unassigned
+    char phoneNumber[MAX_PHONE_LENGTH]; // Empty while the code is unassigned
+} EmergencyEntry;
+
 /**
  * @brief Manages the entire speed dial system.
  * Contains an array of Directory structs and a flag to indicate initialization status.
@@ -40,52 +296,682 @@ typedef struct {
 typedef struct {
     Directory directories[MAX_DIRECTORIES];
     bool initialized; // Flag to indicate if the manager has been initialized
+    bool quiet;       // Suppress per-operation messages (bulk loads, benchmarks)
+    bool realTime;    // Set by enterRealTimeMode(): memory locked, no messages at all
+    _Atomic bool ownerIndexValid; // Cleared by every change; rebuilt on the next bulk join
+    OwnerIndexSlot ownerIndex[OWNER_INDEX_SIZE];
+    _Atomic int totalCount; // Entries across all directories
+    PrefixCounter prefixStats[PREFIX_STATS_COUNTERS]; // Every prefix up to PREFIX_STATS_DEPTH digits
+    EntrySlot slots[TOTAL_NUMBERS]; // Slot map behind EntryId
+    int freeSlotHead;               // First free slot, or -1
+    _Atomic uint64_t lookupCache[LOOKUP_CACHE_SIZE]; // (code hash << 32) | EntryId, 0 if empty
+    _Atomic uint64_t lookupCacheHits;
+    _Atomic uint64_t lookupCacheMisses; // Lookups of existing codes that had to scan the directory
+    DialCount dialsByHour[TOTAL_NUMBERS][HOURS_PER_DAY]; // Per entry slot, learned from the call log
+    EmergencyEntry emergency[MAX_EMERGENCY_ENTRIES];    // Locked in RAM by flagEmergencyEntry()
+    _Atomic int emergencyCount;
 } SpeedDialManager;
 
+/**
+ * @brief A calling number from a CDR batch, tagged with the directory entry that owns it.
+ */
+typedef struct {
+    uint64_t callingNumber; // Packed with packPhoneNumber()
+    EntryId owner;          // Set by enrichCallerIds(); INVALID_ENTRY_ID if no directory owns the number
+} CallerIdRecord;
+
+/**
+ * @brief A read-only, memory-mapped number portability database.
+ * The file is a sorted array of packed records: (number << PORTABILITY_CARRIER_BITS) | carrier.
+ */
+typedef struct {
+    const uint64_t *records; // Sorted ascending; sorting by record also sorts by number
+    size_t count;
+    size_t mappedBytes;
+} PortabilityDb;
+
+/**
+ * @brief Set operations available between two directories.
+ */
+typedef enum {
+    SET_UNION,        // Entries of A, then entries of B whose key is not in A
+    SET_INTERSECTION, // Entries of A whose key is also in B
+    SET_DIFFERENCE    // Entries of A whose key is not in B
+} SetOperation;
+
+/**
+ * @brief Which entry field two directories are compared on.
+ */
+typedef enum {
+    SET_KEY_CODE,
+    SET_KEY_NUMBER
+} SetKey;
+
+/**
+ * @brief Streams the result of a set operation between two directories.
+ * Results point at entries inside the directories; nothing is copied. The probe tables
+ * hold entry indexes (plus one, 0 = empty), so the iterator is only valid until either
+ * directory changes.
+ */
+typedef struct {
+    const Directory *a;
+    const Directory *b;
+    SetOperation operation;
+    SetKey key;
+    int phase;    // 0 while walking A, 1 while walking B (union only)
+    int position; // Next entry to examine in the current phase
+    uint16_t probeA[SET_PROBE_SIZE]; // Keys of A (union only)
+    uint16_t probeB[SET_PROBE_SIZE]; // Keys of B
+} DirectorySetIterator;
+
+/**
+ * @brief The simple tests the scan engine can evaluate against each entry.
+ */
+typedef enum {
+    SCAN_NUMBER_PREFIX,      // Phone number starts with text (e.g., "+44")
+    SCAN_CODE_PREFIX,        // Speed dial code starts with text
+    SCAN_CODE_LONGER_THAN,   // Speed dial code has more than length characters
+    SCAN_NUMBER_LONGER_THAN, // Phone number has more than length characters
+    SCAN_NUMBER_DIGITS_ONLY  // Phone number has no separators or symbols
+} ScanPredicateType;
+
+/**
+ * @brief One predicate of a scan; a scan matches entries satisfying all of its predicates.
+ */
+typedef struct {
+    ScanPredicateType type;
+    const char *text; // For the prefix predicates
+    int length;       // For the length predicates
+} ScanPredicate;
+
+/**
+ * @brief How a dial attempt ended.
+ */
+typedef enum {
+    CALL_DIALED = 0,
+    CALL_NOT_FOUND = 1
+} CallOutcome;
+
+/**
+ * @brief One 28-byte call log record.
+ * Fields are atomics because writers may overwrite a slot while a reader walks it;
+ * sequence is checked before and after reading to discard torn records.
+ * EntryIds are only meaningful within one run, so each record also names its entry
+ * by directory and two independent hashes of its code, which openCallLog() uses to
+ * find the entry again without mistaking a colliding code for it.
+ */
+typedef struct {
+    _Atomic uint32_t sequence;        // (log position + 1) once complete; 0 while being written
+    _Atomic uint32_t entry;           // EntryId dialed, or INVALID_ENTRY_ID
+    _Atomic uint32_t previous;        // sequence of the previous call to the same entry, or 0
+    _Atomic uint32_t timeAndOutcome;  // Seconds since the log's base time << 4 | CallOutcome
+    _Atomic uint32_t directoryIndex;  // Directory of the entry dialed
+    _Atomic uint32_t codeHash;        // hashCode() of the entry's speed dial code
+    _Atomic uint32_t codeCheck;       // hashString() of the code, to confirm a codeHash match
+} CallRecord;
+
+/**
+ * @brief Call log header, stored in front of the records (in memory or in the mapped file).
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t capacity;
+    int64_t baseTime;            // Unix time that timestamp deltas are relative to
+    _Atomic uint64_t head;       // Total records ever appended
+} CallLogHeader;
+
+/**
+ * @brief A call returned by getRecentCalls().
+ */
+typedef struct {
+    time_t timestamp;
+    CallOutcome outcome;
+} CallLogEntry;
+
+/**
+ * @brief The call log ring and the per-entry pointers to each entry's latest call.
+ */
+typedef struct {
+    CallLogHeader *header;
+    CallRecord *records;
+    size_t mappedBytes;                       // Non-zero when backed by a file
+    _Atomic uint32_t lastCall[TOTAL_NUMBERS]; // Per entry slot: sequence of the latest call, or 0
+} CallLog;
+
+/**
+ * @brief The kinds of change published on the change feed.
+ */
+typedef enum {
+    CHANGE_ADD = 1,
+    CHANGE_REMOVE = 2,
+    CHANGE_UPDATE = 3 // An existing entry got a new number
+} ChangeType;
+
+/**
+ * @brief One change to the manager. Events have fixed size, so event n of the
+ * journal file starts at (n - 1) * sizeof(ChangeEvent).
+ */
+typedef struct {
+    uint64_t sequence; // 1 for the first change ever, then consecutive
+    uint8_t type;      // ChangeType
+    uint8_t directoryIndex;
+    uint16_t transactionRemaining; // Events after this one in the same transaction (0 for the last or only one)
+    EntryId id;
+    char speedDialCode[MAX_CODE_LENGTH];
+    char phoneNumber[MAX_PHONE_LENGTH]; // The number added, removed, or (for an update) the new one
+} ChangeEvent;
+
+/**
+ * @brief A follower's position in the change feed.
+ */
+typedef struct {
+    uint64_t nextSequence; // The next event this follower has not seen
+} ChangeCursor;
+
+/**
+ * @brief The events of a transaction, collected until it commits.
+ */
+typedef struct {
+    ChangeEvent events[2 * MAX_TRANSACTION_MOVES];
+    int count;
+} ChangeTransaction;
+
+/**
+ * @brief One entry a transaction moves to another directory.
+ */
+typedef struct {
+    const char *speedDialCode;
+    int fromDirectory;
+    int toDirectory;
+} EntryMove;
+
+/**
+ * @brief Recent changes in memory plus the optional journal holding all of them.
+ * ringSequence[i] is the sequence of the event in ring[i] once it is complete
+ * (0 while it is being rewritten), so readers can detect torn copies.
+ */
+typedef struct {
+    ChangeEvent ring[CHANGE_FEED_CAPACITY];
+    _Atomic uint64_t ringSequence[CHANGE_FEED_CAPACITY];
+    _Atomic uint64_t head;     // Sequence of the latest published event
+    _Atomic uint64_t reserved; // Sequence of the latest event claimed by a writer (head while idle)
+    int journalFd;         // -1 when no journal is open
+} ChangeFeed;
+
+/**
+ * @brief A connection accepted by the lookup server.
+ */
+typedef struct {
+    int fd;          // -1 for an unused connection slot (non-blocking while in use)
+    bool subscribed; // Receives INV lines for every change
+    bool flushOwed;  // INV lines were dropped for lack of outbox room; FLUSH is sent once there is room
+    int listDirectory; // Directory whose listing is being sent, or -1
+    int listNext;      // Next entry of that listing
+    size_t inboxLength;
+    char inbox[SERVER_LINE_LENGTH]; // Bytes of a request line not yet complete
+    size_t outboxLength;
+    char outbox[SERVER_OUTBOX_LENGTH]; // Bytes queued for the client that the socket has not taken yet
+} ServerConnection;
+
+/**
+ * @brief A metrics scrape being served by the lookup server's event loop.
+ */
+typedef struct {
+    int fd;          // -1 for an unused slot (non-blocking while in use)
+    char *response;  // Header and page, built once the request arrives; NULL until then
+    size_t responseLength;
+    size_t sent;
+    uint64_t deadline; // nowNanoseconds() after which the scrape is dropped
+} MetricsConnection;
+
+/**
+ * @brief A lookup cached by a client.
+ */
+typedef struct {
+    bool valid;
+    char directoryName[MAX_DIR_NAME_LENGTH];
+    char speedDialCode[MAX_CODE_LENGTH];
+    char phoneNumber[MAX_PHONE_LENGTH];
+} ClientCacheEntry;
+
+/**
+ * @brief A connection to a lookup server with a local, invalidation-driven cache.
+ */
+typedef struct {
+    int fd;
+    size_t inboxLength;
+    char inbox[SERVER_LINE_LENGTH * 4]; // Received bytes not yet consumed as lines
+    ClientCacheEntry cache[CLIENT_CACHE_SIZE];
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t invalidations;
+} SpeedDialClient;
+
+/**
+ * @brief The operations with metrics (counts by outcome and a latency histogram).
+ */
+typedef enum {
+    METRIC_ADD,
+    METRIC_GET,
+    METRIC_REMOVE,
+    METRIC_DIAL,
+    METRIC_UPDATE,
+    METRIC_UPSERT,
+    METRIC_CAS,
+    METRIC_OPERATION_COUNT
+} MetricOperation;
+
+/**
+ * @brief One thread's metrics. Only its own thread writes to a shard, so updates
+ * never contend; exporters sum the shards with plain atomic loads while they change.
+ */
+typedef struct {
+    _Alignas(64) _Atomic uint64_t succeeded[METRIC_OPERATION_COUNT];
+    _Atomic uint64_t failed[METRIC_OPERATION_COUNT];
+    _Atomic uint64_t latencyBuckets[METRIC_OPERATION_COUNT][LATENCY_BUCKETS];
+    _Atomic uint64_t latencySum[METRIC_OPERATION_COUNT]; // Nanoseconds
+} MetricsShard;
+
+/**
+ * @brief A named amount of memory, as listed by the footprint report and metrics.
+ */
+typedef struct {
+    const char *component;
+    size_t bytes;
+} MemoryComponent;
+
+/**
+ * @brief The manager operations a trace records.
+ */
+typedef enum {
+    TRACE_ADD = 1,
+    TRACE_GET = 2,
+    TRACE_REMOVE = 3,
+    TRACE_DIAL = 4,
+    TRACE_UPDATE = 5,
+    TRACE_UPSERT = 6,
+    TRACE_OPERATION_COUNT
+} TraceOperation;
+
+/**
+ * @brief One traced operation. Codes and numbers are stored only as salted hashes;
+ * the salt is never written, so a trace cannot be matched against known codes.
+ */
+typedef struct {
+    uint64_t timestamp; // Nanoseconds since the trace started
+    uint32_t codeKey;
+    uint32_t numberKey; // TRACE_ADD, TRACE_UPDATE and TRACE_UPSERT only
+    uint8_t operation;  // TraceOperation
+    uint8_t directoryIndex;
+    uint8_t reserved[6];
+} TraceRecord;
+
+/**
+ * @brief The start of a trace file; records follow in the order their buffers were
+ * written, which is only roughly time order when several threads recorded.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t recordSize;
+    int64_t startTime; // Wall-clock seconds when recording started
+} TraceHeader;
+
+/**
+ * @brief Records collected by one thread.
+ */
+typedef struct {
+    int count;
+    TraceRecord records[TRACE_BUFFER_RECORDS];
+} TraceBuffer;
+
+/**
+ * @brief The active trace. Threads append to their own buffer and reserve file space
+ * for a full buffer with one atomic add, so recording takes no locks.
+ */
+typedef struct {
+    _Atomic bool active;
+    int fd;
+    uint32_t salt;
+    uint32_t generation; // Bumped by each startTrace(), so threads take a new buffer for each trace
+    uint64_t startNanoseconds;
+    _Atomic uint64_t fileRecords; // Records written or reserved in the file
+    TraceBuffer *buffers[MAX_TRACE_THREADS];
+    _Atomic int bufferCount;
+} TraceRecorder;
+
+/**
+ * @brief Request classes for rate limiting and load shedding, cheapest to shed last.
+ */
+typedef enum {
+    REQUEST_EMERGENCY, // GET of a flagged entry: never shed or rate limited, always served first
+    REQUEST_DIAL, // GET: never shed, only rate limited
+    REQUEST_EDIT, // ADD, DEL
+    REQUEST_BULK, // LIST
+    REQUEST_CLASS_COUNT
+} RequestClass;
+
+/**
+ * @brief Tokens one core has leased from its tenant's bucket and not used yet.
+ */
+typedef struct {
+    _Alignas(64) _Atomic uint32_t tokens; // Own cache line per shard
+} RateLimitShard;
+
+/**
+ * @brief A token bucket for the whole rate, in GCRA form: the bucket state is the single
+ * "theoretical arrival time" of the next request, so taking tokens is one CAS. Cores
+ * lease a few tokens at a time into their shard, so most requests touch only that.
+ */
+typedef struct {
+    uint64_t interval;  // Nanoseconds between requests; 0 means unlimited
+    uint64_t tolerance; // Burst allowance, in nanoseconds
+    uint32_t lease;     // Tokens a shard takes from the bucket at once
+    _Alignas(64) _Atomic uint64_t theoreticalArrival; // Nanoseconds
+    RateLimitShard shards[RATE_LIMIT_SHARDS];
+} RateLimiter;
+
 // --- Global Manager Instance ---
 // This makes the manager accessible throughout the program.
 // For larger applications, it's often better to pass a pointer to the manager.
 SpeedDialManager manager;
 
+// Operation messages go through this so bulk callers can silence them with manager.quiet.
+#define MANAGER_LOG(...) do { if (!manager.quiet && !manager.realTime) printf(__VA_ARGS__); } while (0)
+PortabilityDb portabilityDb; // Empty until openPortabilityDb() succeeds
+CallLog callLog;             // In memory unless openCallLog() maps a file
+ChangeFeed changeFeed = {.journalFd = -1};
+RateLimiter rateLimits[MAX_DIRECTORIES][REQUEST_CLASS_COUNT]; // Per tenant (directory); all unlimited initially
+_Atomic uint64_t rejectedRequests[REQUEST_CLASS_COUNT];       // Refused by a rate limit or shed
+#ifdef SPEEDDIAL_STATIC_STORAGE
+// Directory storage for builds without a heap; initializeSpeedDialManager() points the directories here.
+static SpeedDialEntry staticEntries[MAX_DIRECTORIES][MAX_NUMBERS_PER_DIRECTORY];
+static DirectoryColumns staticColumns[MAX_DIRECTORIES];
+#endif
+TraceRecorder traceRecorder = {.fd = -1};
+_Atomic bool metricsEnabled;                 // Set by enableMetrics()
+MetricsShard metricsShards[MAX_METRICS_THREADS];
+_Atomic int metricsShardCount;
+
+// --- Static Tracepoints ---
+// USDT probes for bpftrace, perf and SystemTap (provider "speeddial"), compiled in
+// whenever <sys/sdt.h> is available (-DSPEEDDIAL_NO_USDT leaves them out):
+//
+//   add__entry, get__entry, remove__entry, dial__entry      (directory, code length)
+//   add__return, get__return, remove__return, dial__return  (directory, code length, outcome)
+//   update__entry, upsert__entry                            (directory, code length)
+//   update__return, upsert__return                          (directory, code length, outcome)
+//   cas__entry                                              (directory, code length, expected version)
+//   cas__return                                             (directory, code length, outcome)
+//   remove__batch__entry                                    (directory, codes)
+//   remove__batch__return                                   (directory, codes, entries removed)
+//   transaction__entry                                      (entries to move)
+//   transaction__return                                     (entries to move, outcome)
+//   journal__commit__entry                                  (first sequence, events)
+//   journal__commit__return                                 (first sequence, outcome)
+//
+// directory is the directory index or -1; outcome is 1 for added/found/removed/dialed/
+// updated or written, 0 otherwise. Each probe is a nop plus a test of its semaphore, which a
+// tracer raises while attached, so arguments are only computed while tracing. E.g.
+//   bpftrace -e 'usdt:./speeddial:speeddial:get__entry { @s[tid] = nsecs }
+//                usdt:./speeddial:speeddial:get__return { @ns = hist(nsecs - @s[tid]) }'
+#ifdef SPEEDDIAL_USDT
+#define PROBE_SEMAPHORE(name) \
+    __extension__ unsigned short speeddial_##name##_semaphore __attribute__((unused, section(".probes")))
+#define SPEEDDIAL_PROBE(name, ...)                                                     \
+    do {                                                                               \
+        if (__builtin_expect(speeddial_##name##_semaphore != 0, 0)) {                  \
+            STAP_PROBEV(speeddial, name, __VA_ARGS__);                                 \
+        }                                                                              \
+    } while (0)
+PROBE_SEMAPHORE(add__entry);
+PROBE_SEMAPHORE(add__return);
+PROBE_SEMAPHORE(get__entry);
+PROBE_SEMAPHORE(get__return);
+PROBE_SEMAPHORE(remove__entry);
+PROBE_SEMAPHORE(remove__return);
+PROBE_SEMAPHORE(dial__entry);
+PROBE_SEMAPHORE(dial__return);
+PROBE_SEMAPHORE(update__entry);
+PROBE_SEMAPHORE(update__return);
+PROBE_SEMAPHORE(upsert__entry);
+PROBE_SEMAPHORE(upsert__return);
+PROBE_SEMAPHORE(cas__entry);
+PROBE_SEMAPHORE(cas__return);
+PROBE_SEMAPHORE(remove__batch__entry);
+PROBE_SEMAPHORE(remove__batch__return);
+PROBE_SEMAPHORE(transaction__entry);
+PROBE_SEMAPHORE(transaction__return);
+PROBE_SEMAPHORE(journal__commit__entry);
+PROBE_SEMAPHORE(journal__commit__return);
+#else
+#define SPEEDDIAL_PROBE(name, ...) do { } while (0)
+#endif
+
+// Records a manager operation when a trace is active; a single relaxed load otherwise.
+#define TRACE_OPERATION(operation, directoryName, speedDialCode, phoneNumber)                        \
+    do {                                                                                             \
+        if (atomic_load_explicit(&traceRecorder.active, memory_order_relaxed)) {                     \
+            traceOperation(operation, directoryName, speedDialCode, phoneNumber);                    \
+        }                                                                                            \
+    } while (0)
+
 // --- Function Prototypes ---
 void initializeSpeedDialManager();
 bool addNumber(const char *directoryName, const char *speedDialCode, const char *phoneNumber);
 const char *getPhoneNumber(const char *directoryName, const char *speedDialCode);
 bool removeNumber(const char *directoryName, const char *speedDialCode);
+int removeNumbersBatch(const char *directoryName, const char *const *speedDialCodes, int count);
+bool updateNumber(const char *directoryName, const char *speedDialCode, const char *phoneNumber);
+bool upsertNumber(const char *directoryName, const char *speedDialCode, const char *phoneNumber);
+uint32_t getEntryVersion(const char *directoryName, const char *speedDialCode);
+bool copyPhoneNumber(const char *directoryName, const char *speedDialCode, char *phoneNumber);
+bool casNumber(const char *directoryName, const char *speedDialCode, uint32_t expectedVersion, const char *phoneNumber);
+bool moveNumber(const char *fromDirectory, const char *toDirectory, const char *speedDialCode);
+bool swapNumbers(const char *directoryA, const char *speedDialCodeA, const char *directoryB, const char *speedDialCodeB);
+bool reassignNumbers(const char *fromDirectory, const char *toDirectory, const char *const *speedDialCodes, int count);
 void listNumbersInDirectory(const char *directoryName);
 void listAllDirectoryNames();
 void freeSpeedDialManager();
+uint64_t packPhoneNumber(const char *phoneNumber);
+bool writePortabilityDb(const char *path, uint64_t *records, size_t count);
+bool openPortabilityDb(const char *path);
+void closePortabilityDb();
+bool lookupPortedCarrier(const char *phoneNumber, unsigned *carrier);
+const char *getPhoneNumberWithCarrier(const char *directoryName, const char *speedDialCode, unsigned *carrier);
+size_t enrichCallerIds(CallerIdRecord *records, size_t count, int threads);
+bool beginDirectorySetOperation(DirectorySetIterator *it, const char *directoryA, const char *directoryB,
+                                SetOperation operation, SetKey key);
+const SpeedDialEntry *nextSetResult(DirectorySetIterator *it);
+void radixSortStrings(const char **keys, size_t count, int threads);
+void listNumbersInDirectorySorted(const char *directoryName);
+bool exportDirectory(const char *directoryName, FILE *out);
+size_t scanEntries(const ScanPredicate *predicates, int predicateCount, int firstDirectory, int lastDirectory,
+                   EntryId *matches, size_t maxMatches, int threads);
+bool setDirectoryQuota(const char *directoryName, int quota);
+bool getDirectoryStats(const char *directoryName, DirectoryStats *stats);
+int getPrefixCount(const char *prefix, const char *directoryName);
+void printCapacityReport();
+void printFootprintReport();
+bool getDirectoryMemory(const char *directoryName, DirectoryMemory *memory);
+void printDirectoryMemoryReport();
+void enableMetrics(bool enabled);
+void writeMetrics(FILE *out);
+bool writeMetricsFile(const char *path);
+bool listenForMetrics(int port);
+EntryId getEntryId(const char *directoryName, const char *speedDialCode);
+const SpeedDialEntry *getEntryById(EntryId id, int *directoryIndex);
+bool openCallLog(const char *path);
+void closeCallLog();
+bool dialSpeedDial(const char *directoryName, const char *speedDialCode);
+int getRecentCalls(const char *directoryName, const char *speedDialCode, CallLogEntry *calls, int maxCalls);
+bool flagEmergencyEntry(const char *directoryName, const char *speedDialCode);
+bool getEmergencyNumber(const char *directoryName, const char *speedDialCode, char *phoneNumber);
+bool enterRealTimeMode();
+void leaveRealTimeMode();
+void resetLookupCache();
+void getLookupCacheStats(uint64_t *hits, uint64_t *misses);
+void learnDialPatterns();
+int warmLookupCache(int hour);
+bool openChangeJournal(const char *path);
+void closeChangeJournal();
+ChangeCursor subscribeChanges(bool fromStart);
+int readChanges(ChangeCursor *cursor, ChangeEvent *events, int maxEvents);
+int runSpeedDialServer(const char *socketPath);
+void stopSpeedDialServer();
+bool connectSpeedDialClient(SpeedDialClient *client, const char *socketPath);
+const char *clientGetPhoneNumber(SpeedDialClient *client, const char *directoryName, const char *speedDialCode);
+void disconnectSpeedDialClient(SpeedDialClient *client);
+bool setRateLimit(const char *directoryName, RequestClass requestClass, double perSecond, double burst);
+bool admitRequest(int dirIndex, RequestClass requestClass);
+bool startTrace(const char *path);
+void stopTrace();
+int replayTrace(const char *path, double speed);
+int runBenchmarks(int argc, char **argv);
 
 // --- Function Implementations ---
 
+/**
+ * @brief Finds a directory by name.
+ * @return The directory index, or -1 if no directory has that name.
+ */
+static int findDirectoryIndex(const char *directoryName) {
+    for (int i = 0; i < MAX_DIRECTORIES; i++) {
+        if (strcmp(manager.directories[i].name, directoryName) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static inline uint32_t hashString(const char *text) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)text; *p != '\0'; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static uint64_t nowNanoseconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Packs a code into a short key.
+ * Reads at most SHORT_KEY_SCAN_LENGTH bytes, so a code field of MAX_CODE_LENGTH bytes is
+ * never read past. When codes fit short keys outright, a longer argument is packed by
+ * its first SHORT_KEY_LENGTH bytes; it matches no stored code, whose lengths are shorter.
+ * @return The length of the code if it fits in SHORT_KEY_LENGTH bytes; -1 for longer codes.
+ */
+static inline int makeShortKey(const char *speedDialCode, ShortKey *key) {
+    char padded[SHORT_KEY_LENGTH] = {0};
+    size_t length = strnlen(speedDialCode, SHORT_KEY_SCAN_LENGTH);
+    if (length > SHORT_KEY_LENGTH) {
+        return -1;
+    }
+    memcpy(padded, speedDialCode, length);
+    memcpy(key->word, padded, SHORT_KEY_LENGTH);
+    return (int)length;
+}
+
+/**
+ * @brief Hashes a speed dial code: a couple of multiplies for codes that fit a short key,
+ * FNV-1a over the text for longer ones.
+ */
+static inline uint32_t hashCode(const char *speedDialCode) {
+    ShortKey key;
+    if (makeShortKey(speedDialCode, &key) < 0) {
+        return hashString(speedDialCode);
+    }
+    uint64_t hash = (key.word[0] ^ key.word[1] * 0x9E3779B97F4A7C15ull) * 0xC2B2AE3D27D4EB4Full;
+    return (uint32_t)(hash >> 32);
+}
+
+static int findCodeIndex(const Directory *dir, const char *speedDialCode);
+static void setScanColumns(Directory *dir, int index);
+static void setScanNumberColumns(Directory *dir, int index);
+static void removeScanColumns(Directory *dir, int index);
+static void moveScanColumns(Directory *dir, int from, int to);
+static void buildSetProbe(uint16_t *probe, const Directory *dir, SetKey key);
+static int setProbeFind(const uint16_t *probe, const Directory *dir, SetKey key, const char *field);
+static void updatePrefixStats(int dirIndex, const char *phoneNumber, int delta);
+static EntryId allocateEntrySlot(int dirIndex, int entryIndex);
+static void releaseEntrySlot(EntryId id);
+static const SpeedDialEntry *lookupCacheGet(int dirIndex, const char *speedDialCode, uint32_t codeHash);
+static void lookupCachePut(int dirIndex, uint32_t codeHash, EntryId id);
+static void publishChange(ChangeType type, int dirIndex, const SpeedDialEntry *entry);
+static int findEmergencySlot(int dirIndex, const char *speedDialCode);
+static bool readEmergencyNumber(int slot, char *phoneNumber, EntryId *id);
+static void updateEmergencyEntry(int dirIndex, const SpeedDialEntry *entry, bool assigned);
+static void traceOperation(TraceOperation operation, const char *directoryName, const char *speedDialCode,
+                           const char *phoneNumber);
+static _Thread_local bool traceInsideDial; // The dial is traced; its own lookup is not
+static _Thread_local ChangeTransaction *openTransaction; // publishChange() collects events here while set
+static bool addNumberUnprobed(const char *directoryName, const char *speedDialCode, const char *phoneNumber);
+static const char *getPhoneNumberUnprobed(const char *directoryName, const char *speedDialCode);
+static bool removeNumberUnprobed(const char *directoryName, const char *speedDialCode);
+static int removeNumbersBatchUnprobed(const char *directoryName, const char *const *speedDialCodes, int count);
+static bool dialSpeedDialUnprobed(const char *directoryName, const char *speedDialCode);
+static bool updateNumberUnprobed(const char *directoryName, const char *speedDialCode, const char *phoneNumber);
+static bool upsertNumberUnprobed(const char *directoryName, const char *speedDialCode, const char *phoneNumber);
+static bool casNumberUnprobed(const char *directoryName, const char *speedDialCode, uint32_t expectedVersion,
+                              const char *phoneNumber);
+static void appendEntry(int dirIndex, const char *speedDialCode, const char *phoneNumber);
+static void closeEntryGap(Directory *dir, int entryIndex);
+static uint32_t claimEntry(EntryId id);
+static void releaseEntry(EntryId id, uint32_t version);
+static uint64_t metricsStart();
+static void recordMetric(MetricOperation operation, uint64_t start, bool succeeded);
+
 /**
  * @brief Initializes the SpeedDialManager.
  * Sets up the predefined number of directories and allocates initial memory for their entries.
  */
 void initializeSpeedDialManager() {
     if (manager.initialized) {
-        printf("SpeedDialManager already initialized.\n");
+        MANAGER_LOG("SpeedDialManager already initialized.\n");
         return;
     }
 
-    printf("Initializing SpeedDialManager with %d directories...\n", MAX_DIRECTORIES);
+    MANAGER_LOG("Initializing SpeedDialManager with %d directories...\n", MAX_DIRECTORIES);
     for (int i = 0; i < MAX_DIRECTORIES; i++) {
         // Construct directory name (e.g., "Directory 1")
         snprintf(manager.directories[i].name, MAX_DIR_NAME_LENGTH, "Directory %d", i + 1);
         manager.directories[i].currentCount = 0;
+        manager.directories[i].quota = MAX_NUMBERS_PER_DIRECTORY;
+#ifdef SPEEDDIAL_STATIC_STORAGE
+        manager.directories[i].entries = staticEntries[i];
+        manager.directories[i].columns = &staticColumns[i];
+        memset(&staticColumns[i], 0, sizeof(DirectoryColumns));
+#else
         // Allocate initial memory for entries. We can realloc later if needed,
         // but allocating for MAX_NUMBERS_PER_DIRECTORY upfront simplifies things
         // for this fixed-capacity scenario.
         manager.directories[i].entries = (SpeedDialEntry *)malloc(MAX_NUMBERS_PER_DIRECTORY * sizeof(SpeedDialEntry));
-        if (manager.directories[i].entries == NULL) {
+        manager.directories[i].columns = (DirectoryColumns *)calloc(1, sizeof(DirectoryColumns));
+#endif
+        if (manager.directories[i].entries == NULL || manager.directories[i].columns == NULL) {
             perror("Failed to allocate memory for directory entries");
             // Handle error: potentially free already allocated memory and exit
             freeSpeedDialManager(); // Clean up what was allocated so far
             exit(EXIT_FAILURE);
         }
     }
+    manager.ownerIndexValid = false;
+    manager.totalCount = 0;
+    memset(manager.prefixStats, 0, sizeof(manager.prefixStats));
+    for (int i = 0; i < TOTAL_NUMBERS; i++) {
+        manager.slots[i].generation = 1;
+        manager.slots[i].directoryIndex = -1;
+        manager.slots[i].entryIndex = (int16_t)(i + 1 < TOTAL_NUMBERS ? i + 1 : -1);
+    }
+    manager.freeSlotHead = 0;
+    resetLookupCache();
+    memset(manager.dialsByHour, 0, sizeof(manager.dialsByHour));
+    atomic_store(&manager.emergencyCount, 0);
     manager.initialized = true;
-    printf("SpeedDialManager initialized successfully.\n");
+    MANAGER_LOG("SpeedDialManager initialized successfully.\n");
 }
 
 /**
@@ -98,8 +984,18 @@ void initializeSpeedDialManager() {
  * the directory is full, or the speed dial code already exists within that directory.
  */
 bool addNumber(const char *directoryName, const char *speedDialCode, const char *phoneNumber) {
+    SPEEDDIAL_PROBE(add__entry, findDirectoryIndex(directoryName), strlen(speedDialCode));
+    uint64_t start = metricsStart();
+    bool added = addNumberUnprobed(directoryName, speedDialCode, phoneNumber);
+    recordMetric(METRIC_ADD, start, added);
+    SPEEDDIAL_PROBE(add__return, findDirectoryIndex(directoryName), strlen(speedDialCode), added);
+    return added;
+}
+
+static bool addNumberUnprobed(const char *directoryName, const char *speedDialCode, const char *phoneNumber) {
+    TRACE_OPERATION(TRACE_ADD, directoryName, speedDialCode, phoneNumber);
     if (!manager.initialized) {
-        printf("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
         return false;
     }
 
@@ -113,7 +1009,7 @@ bool addNumber(const char *directoryName, const char *speedDialCode, const char
     }
 
     if (dirIndex == -1) {
-        printf("Error: Directory '%s' does not exist. Cannot add number.\n", directoryName);
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot add number.\n", directoryName);
         return false;
     }
 
@@ -121,27 +1017,38 @@ bool addNumber(const char *directoryName, const char *speedDialCode, const char
 
     // Check if the directory has reached its maximum capacity.
     if (dir->currentCount >= MAX_NUMBERS_PER_DIRECTORY) {
-        printf("Error: Directory '%s' is full. Max %d numbers allowed. Cannot add number.\n", directoryName, MAX_NUMBERS_PER_DIRECTORY);
+        MANAGER_LOG("Error: Directory '%s' is full. Max %d numbers allowed. Cannot add number.\n", directoryName, MAX_NUMBERS_PER_DIRECTORY);
         return false;
     }
 
     // Check if the speed dial code already exists in this directory.
-    for (int i = 0; i < dir->currentCount; i++) {
-        if (strcmp(dir->entries[i].speedDialCode, speedDialCode) == 0) {
-            printf("Error: Speed dial code '%s' already exists in '%s'. Cannot add duplicate.\n", speedDialCode, directoryName);
-            return false;
-        }
+    if (findCodeIndex(dir, speedDialCode) != -1) {
+        MANAGER_LOG("Error: Speed dial code '%s' already exists in '%s'. Cannot add duplicate.\n", speedDialCode, directoryName);
+        return false;
     }
 
-    // Add the new speed dial entry
+    appendEntry(dirIndex, speedDialCode, phoneNumber);
+    MANAGER_LOG("Successfully added '%s' -> '%s' to '%s'.\n", speedDialCode, phoneNumber, directoryName);
+    return true;
+}
+
+/**
+ * @brief Adds an entry for a code known not to be in its directory, which has room for it.
+ */
+static void appendEntry(int dirIndex, const char *speedDialCode, const char *phoneNumber) {
+    Directory *dir = &manager.directories[dirIndex];
     strncpy(dir->entries[dir->currentCount].speedDialCode, speedDialCode, MAX_CODE_LENGTH - 1);
     dir->entries[dir->currentCount].speedDialCode[MAX_CODE_LENGTH - 1] = '\0'; // Ensure null-termination
     strncpy(dir->entries[dir->currentCount].phoneNumber, phoneNumber, MAX_PHONE_LENGTH - 1);
     dir->entries[dir->currentCount].phoneNumber[MAX_PHONE_LENGTH - 1] = '\0'; // Ensure null-termination
 
+    dir->entries[dir->currentCount].id = allocateEntrySlot(dirIndex, dir->currentCount);
+    setScanColumns(dir, dir->currentCount);
+    updatePrefixStats(dirIndex, phoneNumber, +1);
+    publishChange(CHANGE_ADD, dirIndex, &dir->entries[dir->currentCount]);
+    updateEmergencyEntry(dirIndex, &dir->entries[dir->currentCount], true);
     dir->currentCount++;
-    printf("Successfully added '%s' -> '%s' to '%s'.\n", speedDialCode, phoneNumber, directoryName);
-    return true;
+    manager.ownerIndexValid = false;
 }
 
 /**
@@ -150,11 +1057,25 @@ bool addNumber(const char *directoryName, const char *speedDialCode, const char
  * @param directoryName The name of the directory to search within.
  * @param speedDialCode The speed dial code associated with the desired phone number.
  * @return The phone number as a const char* if found; NULL if the directory does not exist
- * or the speed dial code is not found within the directory.
+ * or the speed dial code is not found within the directory. The pointer is into the
+ * entry itself: an editor on another thread may rewrite the number behind it, so
+ * threads that look up while editors run use copyPhoneNumber() instead.
  */
 const char *getPhoneNumber(const char *directoryName, const char *speedDialCode) {
+    SPEEDDIAL_PROBE(get__entry, findDirectoryIndex(directoryName), strlen(speedDialCode));
+    uint64_t start = metricsStart();
+    const char *phoneNumber = getPhoneNumberUnprobed(directoryName, speedDialCode);
+    recordMetric(METRIC_GET, start, phoneNumber != NULL);
+    SPEEDDIAL_PROBE(get__return, findDirectoryIndex(directoryName), strlen(speedDialCode), phoneNumber != NULL);
+    return phoneNumber;
+}
+
+static const char *getPhoneNumberUnprobed(const char *directoryName, const char *speedDialCode) {
+    if (!traceInsideDial) {
+        TRACE_OPERATION(TRACE_GET, directoryName, speedDialCode, NULL);
+    }
     if (!manager.initialized) {
-        printf("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
         return NULL;
     }
 
@@ -168,21 +1089,29 @@ const char *getPhoneNumber(const char *directoryName, const char *speedDialCode)
     }
 
     if (dirIndex == -1) {
-        printf("Error: Directory '%s' does not exist. Cannot retrieve number.\n", directoryName);
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot retrieve number.\n", directoryName);
         return NULL;
     }
 
     Directory *dir = &manager.directories[dirIndex];
 
+    // Recently used (or pre-warmed) codes skip the directory scan
+    uint32_t codeHash = hashCode(speedDialCode);
+    const SpeedDialEntry *cached = lookupCacheGet(dirIndex, speedDialCode, codeHash);
+    if (cached != NULL) {
+        MANAGER_LOG("Retrieved '%s' from '%s': %s\n", speedDialCode, directoryName, cached->phoneNumber);
+        return cached->phoneNumber;
+    }
+
     // Search for the speed dial code
-    for (int i = 0; i < dir->currentCount; i++) {
-        if (strcmp(dir->entries[i].speedDialCode, speedDialCode) == 0) {
-            printf("Retrieved '%s' from '%s': %s\n", speedDialCode, directoryName, dir->entries[i].phoneNumber);
-            return dir->entries[i].phoneNumber;
-        }
+    int entryIndex = findCodeIndex(dir, speedDialCode);
+    if (entryIndex != -1) {
+        lookupCachePut(dirIndex, codeHash, dir->entries[entryIndex].id);
+        MANAGER_LOG("Retrieved '%s' from '%s': %s\n", speedDialCode, directoryName, dir->entries[entryIndex].phoneNumber);
+        return dir->entries[entryIndex].phoneNumber;
     }
 
-    printf("Phone number for speed dial code '%s' not found in '%s'.\n", speedDialCode, directoryName);
+    MANAGER_LOG("Phone number for speed dial code '%s' not found in '%s'.\n", speedDialCode, directoryName);
     return NULL;
 }
 
@@ -195,8 +1124,18 @@ const char *getPhoneNumber(const char *directoryName, const char *speedDialCode)
  * or the speed dial code was not found in the directory.
  */
 bool removeNumber(const char *directoryName, const char *speedDialCode) {
+    SPEEDDIAL_PROBE(remove__entry, findDirectoryIndex(directoryName), strlen(speedDialCode));
+    uint64_t start = metricsStart();
+    bool removed = removeNumberUnprobed(directoryName, speedDialCode);
+    recordMetric(METRIC_REMOVE, start, removed);
+    SPEEDDIAL_PROBE(remove__return, findDirectoryIndex(directoryName), strlen(speedDialCode), removed);
+    return removed;
+}
+
+static bool removeNumberUnprobed(const char *directoryName, const char *speedDialCode) {
+    TRACE_OPERATION(TRACE_REMOVE, directoryName, speedDialCode, NULL);
     if (!manager.initialized) {
-        printf("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
         return false;
     }
 
@@ -210,113 +1149,4565 @@ bool removeNumber(const char *directoryName, const char *speedDialCode) {
     }
 
     if (dirIndex == -1) {
-        printf("Error: Directory '%s' does not exist. Cannot remove number.\n", directoryName);
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot remove number.\n", directoryName);
         return false;
     }
 
     Directory *dir = &manager.directories[dirIndex];
 
     // Find the entry to remove
-    int entryIndex = -1;
-    for (int i = 0; i < dir->currentCount; i++) {
-        if (strcmp(dir->entries[i].speedDialCode, speedDialCode) == 0) {
-            entryIndex = i;
-            break;
-        }
-    }
+    int entryIndex = findCodeIndex(dir, speedDialCode);
 
     if (entryIndex == -1) {
-        printf("Speed dial code '%s' not found in '%s'. No number removed.\n", speedDialCode, directoryName);
+        MANAGER_LOG("Speed dial code '%s' not found in '%s'. No number removed.\n", speedDialCode, directoryName);
         return false;
     }
 
-    // Shift elements to fill the gap created by removal
-    printf("Successfully removed '%s' -> '%s' from '%s'.\n",
-           dir->entries[entryIndex].speedDialCode, dir->entries[entryIndex].phoneNumber, directoryName);
+    updatePrefixStats(dirIndex, dir->entries[entryIndex].phoneNumber, -1);
+    publishChange(CHANGE_REMOVE, dirIndex, &dir->entries[entryIndex]);
+    updateEmergencyEntry(dirIndex, &dir->entries[entryIndex], false);
+    releaseEntrySlot(dir->entries[entryIndex].id);
+
+    MANAGER_LOG("Successfully removed '%s' -> '%s' from '%s'.\n",
+                dir->entries[entryIndex].speedDialCode, dir->entries[entryIndex].phoneNumber, directoryName);
+    closeEntryGap(dir, entryIndex);
+    return true;
+}
+
+/**
+ * @brief Shifts the entries after entries[entryIndex] down over it, keeping the slot
+ * map and scan columns in step. The entry's slot is left to the caller.
+ */
+static void closeEntryGap(Directory *dir, int entryIndex) {
     for (int i = entryIndex; i < dir->currentCount - 1; i++) {
         dir->entries[i] = dir->entries[i + 1];
+        manager.slots[dir->entries[i].id & ((1u << ENTRY_ID_SLOT_BITS) - 1)].entryIndex = (int16_t)i;
     }
+    removeScanColumns(dir, entryIndex);
     dir->currentCount--; // Decrement the count of entries
-
-    return true;
+    manager.ownerIndexValid = false;
 }
 
 /**
- * @brief Lists all speed dial entries (codes and numbers) in a given directory.
+ * @brief Removes many speed dial entries from one directory at once.
+ * The directory's codes are hashed once, each victim is marked through that index,
+ * and the survivors are compacted in a single pass, so removing k codes costs
+ * O(n + k) rather than the O(n * k) of k removeNumber() calls.
  *
- * @param directoryName The name of the directory to list entries from.
+ * @param directoryName The name of the directory to remove entries from.
+ * @param speedDialCodes The codes to remove; codes not in the directory are skipped.
+ * @param count The number of codes.
+ * @return The number of entries removed, or -1 if the directory does not exist.
  */
-void listNumbersInDirectory(const char *directoryName) {
+int removeNumbersBatch(const char *directoryName, const char *const *speedDialCodes, int count) {
+    SPEEDDIAL_PROBE(remove__batch__entry, findDirectoryIndex(directoryName), count);
+    uint64_t start = metricsStart();
+    int removed = removeNumbersBatchUnprobed(directoryName, speedDialCodes, count);
+    recordMetric(METRIC_REMOVE, start, removed > 0); // One sample for the batch, so its latency is not counted k times
+    SPEEDDIAL_PROBE(remove__batch__return, findDirectoryIndex(directoryName), count, removed);
+    return removed;
+}
+
+static int removeNumbersBatchUnprobed(const char *directoryName, const char *const *speedDialCodes, int count) {
+    for (int k = 0; k < count; k++) {
+        TRACE_OPERATION(TRACE_REMOVE, directoryName, speedDialCodes[k], NULL);
+    }
     if (!manager.initialized) {
-        printf("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
-        return;
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return -1;
+    }
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot remove numbers.\n", directoryName);
+        return -1;
     }
+    Directory *dir = &manager.directories[dirIndex];
 
-    // Find the directory
-    int dirIndex = -1;
-    for (int i = 0; i < MAX_DIRECTORIES; i++) {
-        if (strcmp(manager.directories[i].name, directoryName) == 0) {
+    // Mark the victims
+    uint16_t probe[SET_PROBE_SIZE];
+    bool victim[MAX_NUMBERS_PER_DIRECTORY] = {false};
+    int removed = 0;
+    buildSetProbe(probe, dir, SET_KEY_CODE);
+    for (int k = 0; k < count; k++) {
+        size_t length = strlen(speedDialCodes[k]);
+        if (length >= MAX_CODE_LENGTH) {
+            continue; // Longer than any stored code
+        }
+        char padded[MAX_CODE_LENGTH] = {0}; // Probe fields are compared zero padded
+        memcpy(padded, speedDialCodes[k], length);
+        int entryIndex = setProbeFind(probe, dir, SET_KEY_CODE, padded);
+        if (entryIndex != -1 && !victim[entryIndex]) {
+            victim[entryIndex] = true;
+            removed++;
+        }
+    }
+
+    // Retire the victims and close the gaps in one pass
+    if (removed > 0) {
+        int kept = 0;
+        for (int i = 0; i < dir->currentCount; i++) {
+            if (victim[i]) {
+                updatePrefixStats(dirIndex, dir->entries[i].phoneNumber, -1);
+                publishChange(CHANGE_REMOVE, dirIndex, &dir->entries[i]);
+                updateEmergencyEntry(dirIndex, &dir->entries[i], false);
+                releaseEntrySlot(dir->entries[i].id);
+                continue;
+            }
+            if (kept != i) {
+                dir->entries[kept] = dir->entries[i];
+                manager.slots[dir->entries[kept].id & ((1u << ENTRY_ID_SLOT_BITS) - 1)].entryIndex = (int16_t)kept;
+                moveScanColumns(dir, i, kept);
+            }
+            kept++;
+        }
+        dir->currentCount = kept;
+        manager.ownerIndexValid = false;
+    }
+    MANAGER_LOG("Removed %d of %d codes from '%s'.\n", removed, count, directoryName);
+    return removed;
+}
+
+/**
+ * @brief Gives entries[entryIndex] of a directory a new phone number in place.
+ * The entry keeps its position and EntryId, so cached lookups, call history and
+ * emergency pins stay attached to it; one CHANGE_UPDATE event records the edit.
+ * The caller holds the entry's edit claim, which copyPhoneNumber() readers treat as a
+ * seqlock; the code and its scan columns are left alone, so lookups keep finding it.
+ */
+static void writeEntryNumber(int dirIndex, int entryIndex, const char *phoneNumber) {
+    Directory *dir = &manager.directories[dirIndex];
+    SpeedDialEntry *entry = &dir->entries[entryIndex];
+    atomic_thread_fence(memory_order_release); // The claim is visible before any byte of the number changes
+    updatePrefixStats(dirIndex, entry->phoneNumber, -1);
+    strncpy(entry->phoneNumber, phoneNumber, MAX_PHONE_LENGTH - 1);
+    entry->phoneNumber[MAX_PHONE_LENGTH - 1] = '\0'; // Ensure null-termination
+    updatePrefixStats(dirIndex, phoneNumber, +1);
+    setScanNumberColumns(dir, entryIndex);
+    publishChange(CHANGE_UPDATE, dirIndex, entry);
+    updateEmergencyEntry(dirIndex, entry, true);
+    manager.ownerIndexValid = false;
+}
+
+/**
+ * @brief Writes a new number into an entry once no other editor holds it, and bumps its version.
+ */
+static void setEntryNumber(int dirIndex, int entryIndex, const char *phoneNumber) {
+    EntryId id = manager.directories[dirIndex].entries[entryIndex].id;
+    uint32_t version = claimEntry(id);
+    writeEntryNumber(dirIndex, entryIndex, phoneNumber);
+    releaseEntry(id, version + 1);
+}
+
+/**
+ * @brief Changes the phone number of an existing speed dial entry.
+ * Unlike removeNumber() followed by addNumber(), the entry is found once and
+ * overwritten in place, keeping its EntryId.
+ *
+ * @param directoryName The name of the directory holding the entry.
+ * @param speedDialCode The speed dial code of the entry to change.
+ * @param phoneNumber The new phone number.
+ * @return true if the number was changed; false if the directory does not exist
+ * or the speed dial code was not found in the directory.
+ */
+bool updateNumber(const char *directoryName, const char *speedDialCode, const char *phoneNumber) {
+    SPEEDDIAL_PROBE(update__entry, findDirectoryIndex(directoryName), strlen(speedDialCode));
+    uint64_t start = metricsStart();
+    bool updated = updateNumberUnprobed(directoryName, speedDialCode, phoneNumber);
+    recordMetric(METRIC_UPDATE, start, updated);
+    SPEEDDIAL_PROBE(update__return, findDirectoryIndex(directoryName), strlen(speedDialCode), updated);
+    return updated;
+}
+
+static bool updateNumberUnprobed(const char *directoryName, const char *speedDialCode, const char *phoneNumber) {
+    TRACE_OPERATION(TRACE_UPDATE, directoryName, speedDialCode, phoneNumber);
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return false;
+    }
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot update number.\n", directoryName);
+        return false;
+    }
+    int entryIndex = findCodeIndex(&manager.directories[dirIndex], speedDialCode);
+    if (entryIndex == -1) {
+        MANAGER_LOG("Speed dial code '%s' not found in '%s'. No number updated.\n", speedDialCode, directoryName);
+        return false;
+    }
+    setEntryNumber(dirIndex, entryIndex, phoneNumber);
+    MANAGER_LOG("Successfully updated '%s' -> '%s' in '%s'.\n", speedDialCode, phoneNumber, directoryName);
+    return true;
+}
+
+/**
+ * @brief Sets the phone number for a speed dial code, adding the entry if the code is new.
+ * The directory is searched once whichever way it goes.
+ *
+ * @param directoryName The name of the directory.
+ * @param speedDialCode The speed dial code to set.
+ * @param phoneNumber The phone number to store.
+ * @return true if the entry was updated or added; false if the directory does not exist,
+ * or the code is new and the directory is full.
+ */
+bool upsertNumber(const char *directoryName, const char *speedDialCode, const char *phoneNumber) {
+    SPEEDDIAL_PROBE(upsert__entry, findDirectoryIndex(directoryName), strlen(speedDialCode));
+    uint64_t start = metricsStart();
+    bool stored = upsertNumberUnprobed(directoryName, speedDialCode, phoneNumber);
+    recordMetric(METRIC_UPSERT, start, stored);
+    SPEEDDIAL_PROBE(upsert__return, findDirectoryIndex(directoryName), strlen(speedDialCode), stored);
+    return stored;
+}
+
+static bool upsertNumberUnprobed(const char *directoryName, const char *speedDialCode, const char *phoneNumber) {
+    TRACE_OPERATION(TRACE_UPSERT, directoryName, speedDialCode, phoneNumber);
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return false;
+    }
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot set number.\n", directoryName);
+        return false;
+    }
+    Directory *dir = &manager.directories[dirIndex];
+    int entryIndex = findCodeIndex(dir, speedDialCode);
+    if (entryIndex != -1) {
+        setEntryNumber(dirIndex, entryIndex, phoneNumber);
+        MANAGER_LOG("Successfully updated '%s' -> '%s' in '%s'.\n", speedDialCode, phoneNumber, directoryName);
+        return true;
+    }
+    if (dir->currentCount >= MAX_NUMBERS_PER_DIRECTORY) {
+        MANAGER_LOG("Error: Directory '%s' is full. Max %d numbers allowed. Cannot add number.\n", directoryName, MAX_NUMBERS_PER_DIRECTORY);
+        return false;
+    }
+    appendEntry(dirIndex, speedDialCode, phoneNumber);
+    MANAGER_LOG("Successfully added '%s' -> '%s' to '%s'.\n", speedDialCode, phoneNumber, directoryName);
+    return true;
+}
+
+/**
+ * @brief Reads the version of an entry, for a later casNumber().
+ * An entry starts at version 1 when it is added and gains one with each new number.
+ *
+ * @param directoryName The name of the directory holding the entry.
+ * @param speedDialCode The speed dial code of the entry.
+ * @return The version, or 0 if the directory or code does not exist.
+ */
+uint32_t getEntryVersion(const char *directoryName, const char *speedDialCode) {
+    EntryId id = getEntryId(directoryName, speedDialCode);
+    if (id == INVALID_ENTRY_ID) {
+        return 0;
+    }
+    return atomic_load_explicit(&manager.slots[id & ((1u << ENTRY_ID_SLOT_BITS) - 1)].version,
+                                memory_order_acquire) >> 1;
+}
+
+/**
+ * @brief Copies the phone number of an entry, consistent even while editors change it.
+ * The entry's version is its seqlock: a copy that overlapped an edit is taken again.
+ *
+ * @param directoryName The name of the directory holding the entry.
+ * @param speedDialCode The speed dial code of the entry.
+ * @param phoneNumber Receives the number (MAX_PHONE_LENGTH bytes).
+ * @return true if the code was found; false if the directory or code does not exist.
+ */
+bool copyPhoneNumber(const char *directoryName, const char *speedDialCode, char *phoneNumber) {
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1) {
+        return false;
+    }
+    const Directory *dir = &manager.directories[dirIndex];
+    int entryIndex = findCodeIndex(dir, speedDialCode);
+    if (entryIndex == -1) {
+        return false;
+    }
+    const SpeedDialEntry *entry = &dir->entries[entryIndex];
+    _Atomic uint32_t *version = &manager.slots[entry->id & ((1u << ENTRY_ID_SLOT_BITS) - 1)].version;
+    for (;;) {
+        uint32_t before = atomic_load_explicit(version, memory_order_acquire);
+        if ((before & 1) == 0) {
+            memcpy(phoneNumber, entry->phoneNumber, MAX_PHONE_LENGTH);
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(version, memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        sched_yield(); // An editor holds the entry; let it finish, even on a single core
+    }
+}
+
+/**
+ * @brief Changes the phone number of an entry only if nobody has changed it since it
+ * was read at expectedVersion. A conflicting writer fails at once instead of waiting:
+ * it rereads the entry (getEntryVersion()) and decides again.
+ *
+ * No directory is locked. Editors (casNumber(), and updateNumber() and upsertNumber()
+ * on existing codes) may run on several threads alongside lookups, each claiming only
+ * the entry it changes. Editors never touch codes, so lookups always find the entry;
+ * readers on other threads take the number with copyPhoneNumber(), since the pointer
+ * getPhoneNumber() returns may be rewritten under them. Adding and removing entries
+ * moves others, so those stay with one writer thread that does not run while editors do.
+ *
+ * @param directoryName The name of the directory holding the entry.
+ * @param speedDialCode The speed dial code of the entry to change.
+ * @param expectedVersion The version the caller's change is based on.
+ * @param phoneNumber The new phone number.
+ * @return true if the number was changed (the entry is now at expectedVersion + 1);
+ * false if the entry is missing, at another version, or being changed right now.
+ */
+bool casNumber(const char *directoryName, const char *speedDialCode, uint32_t expectedVersion, const char *phoneNumber) {
+    SPEEDDIAL_PROBE(cas__entry, findDirectoryIndex(directoryName), strlen(speedDialCode), expectedVersion);
+    uint64_t start = metricsStart();
+    bool swapped = casNumberUnprobed(directoryName, speedDialCode, expectedVersion, phoneNumber);
+    recordMetric(METRIC_CAS, start, swapped);
+    SPEEDDIAL_PROBE(cas__return, findDirectoryIndex(directoryName), strlen(speedDialCode), swapped);
+    return swapped;
+}
+
+static bool casNumberUnprobed(const char *directoryName, const char *speedDialCode, uint32_t expectedVersion,
+                              const char *phoneNumber) {
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return false;
+    }
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot update number.\n", directoryName);
+        return false;
+    }
+    int entryIndex = findCodeIndex(&manager.directories[dirIndex], speedDialCode);
+    if (entryIndex == -1) {
+        MANAGER_LOG("Speed dial code '%s' not found in '%s'. No number updated.\n", speedDialCode, directoryName);
+        return false;
+    }
+    EntryId id = manager.directories[dirIndex].entries[entryIndex].id;
+    _Atomic uint32_t *version = &manager.slots[id & ((1u << ENTRY_ID_SLOT_BITS) - 1)].version;
+    uint32_t expected = expectedVersion << 1;
+    if (!atomic_compare_exchange_strong_explicit(version, &expected, expected | 1, memory_order_acquire,
+                                                 memory_order_relaxed)) {
+        MANAGER_LOG("Version conflict on '%s' in '%s': expected %u, found %u%s.\n", speedDialCode, directoryName,
+                    expectedVersion, expected >> 1, (expected & 1) ? " (being changed)" : "");
+        return false;
+    }
+    TRACE_OPERATION(TRACE_UPDATE, directoryName, speedDialCode, phoneNumber); // Replays as the update it became
+    writeEntryNumber(dirIndex, entryIndex, phoneNumber);
+    releaseEntry(id, expectedVersion + 1);
+    MANAGER_LOG("Successfully updated '%s' -> '%s' in '%s' (version %u).\n", speedDialCode, phoneNumber,
+                directoryName, expectedVersion + 1);
+    return true;
+}
+
+/**
+ * @brief Lists all speed dial entries (codes and numbers) in a given directory.
+ *
+ * @param directoryName The name of the directory to list entries from.
+ */
+void listNumbersInDirectory(const char *directoryName) {
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return;
+    }
+
+    // Find the directory
+    int dirIndex = -1;
+    for (int i = 0; i < MAX_DIRECTORIES; i++) {
+        if (strcmp(manager.directories[i].name, directoryName) == 0) {
             dirIndex = i;
             break;
         }
     }
 
-    if (dirIndex == -1) {
-        printf("Error: Directory '%s' does not exist. Cannot list numbers.\n", directoryName);
-        return;
+    if (dirIndex == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot list numbers.\n", directoryName);
+        return;
+    }
+
+    Directory *dir = &manager.directories[dirIndex];
+
+    printf("\n--- Listing numbers in '%s' (%d/%d) ---\n",
+           directoryName, dir->currentCount, MAX_NUMBERS_PER_DIRECTORY);
+    if (dir->currentCount == 0) {
+        printf("  Directory is empty.\n");
+    } else {
+        for (int i = 0; i < dir->currentCount; i++) {
+            printf("  %s: %s\n", dir->entries[i].speedDialCode, dir->entries[i].phoneNumber);
+        }
+    }
+}
+
+/**
+ * @brief Lists the names of all directories currently managed by the speed dial manager.
+ */
+void listAllDirectoryNames() {
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return;
+    }
+
+    printf("\n--- All available directories ---\n");
+    for (int i = 0; i < MAX_DIRECTORIES; i++) {
+        printf("  %s\n", manager.directories[i].name);
+    }
+}
+
+/**
+ * @brief Frees all dynamically allocated memory used by the SpeedDialManager.
+ * This should be called before the program exits to prevent memory leaks.
+ */
+void freeSpeedDialManager() {
+    if (!manager.initialized) {
+        MANAGER_LOG("SpeedDialManager not initialized or already freed.\n");
+        return;
+    }
+
+    MANAGER_LOG("Freeing SpeedDialManager memory...\n");
+    for (int i = 0; i < MAX_DIRECTORIES; i++) {
+#ifndef SPEEDDIAL_STATIC_STORAGE
+        if (manager.directories[i].entries != NULL) {
+            free(manager.directories[i].entries);
+        }
+        free(manager.directories[i].columns);
+#endif
+        manager.directories[i].entries = NULL; // Prevent double free
+        manager.directories[i].columns = NULL;
+    }
+    manager.initialized = false;
+    MANAGER_LOG("SpeedDialManager memory freed.\n");
+}
+
+// --- Stable Entry IDs ---
+
+/**
+ * @brief Takes a free slot for the entry at entries[entryIndex] of a directory.
+ * Cannot fail: there are TOTAL_NUMBERS slots and no more entries than that.
+ */
+static EntryId allocateEntrySlot(int dirIndex, int entryIndex) {
+    int slot = manager.freeSlotHead;
+    manager.freeSlotHead = manager.slots[slot].entryIndex;
+    manager.slots[slot].directoryIndex = (int16_t)dirIndex;
+    manager.slots[slot].entryIndex = (int16_t)entryIndex;
+    atomic_store_explicit(&manager.slots[slot].version, 1u << 1, memory_order_release);
+    return ((EntryId)manager.slots[slot].generation << ENTRY_ID_SLOT_BITS) | (EntryId)slot;
+}
+
+/**
+ * @brief Returns an entry's slot to the free list, making every copy of its id stale.
+ */
+static void releaseEntrySlot(EntryId id) {
+    int slot = (int)(id & ((1u << ENTRY_ID_SLOT_BITS) - 1));
+    EntrySlot *entrySlot = &manager.slots[slot];
+    entrySlot->generation = (uint16_t)(entrySlot->generation == UINT16_MAX ? 1 : entrySlot->generation + 1);
+    entrySlot->directoryIndex = -1;
+    entrySlot->entryIndex = (int16_t)manager.freeSlotHead;
+    manager.freeSlotHead = slot;
+}
+
+/**
+ * @brief Takes the edit claim on an entry, waiting while another editor holds it.
+ * Edits are short (no I/O besides an optional journal write), so the wait is a spin.
+ * @return The entry's version before this edit.
+ */
+static uint32_t claimEntry(EntryId id) {
+    _Atomic uint32_t *version = &manager.slots[id & ((1u << ENTRY_ID_SLOT_BITS) - 1)].version;
+    for (;;) {
+        uint32_t current = atomic_load_explicit(version, memory_order_relaxed);
+        if ((current & 1) == 0 && atomic_compare_exchange_weak_explicit(version, &current, current | 1,
+                                                                        memory_order_acquire, memory_order_relaxed)) {
+            return current >> 1;
+        }
+        sched_yield(); // Let the holder finish, even on a single core
+    }
+}
+
+/**
+ * @brief Gives up the edit claim on an entry, leaving it at the given version.
+ */
+static void releaseEntry(EntryId id, uint32_t version) {
+    atomic_store_explicit(&manager.slots[id & ((1u << ENTRY_ID_SLOT_BITS) - 1)].version, version << 1,
+                          memory_order_release);
+}
+
+/**
+ * @brief Looks up the stable id of an entry.
+ *
+ * @param directoryName The name of the directory to search within.
+ * @param speedDialCode The speed dial code of the entry.
+ * @return The entry's id, or INVALID_ENTRY_ID if the directory or code does not exist.
+ */
+EntryId getEntryId(const char *directoryName, const char *speedDialCode) {
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1) {
+        return INVALID_ENTRY_ID;
+    }
+    const Directory *dir = &manager.directories[dirIndex];
+    int entryIndex = findCodeIndex(dir, speedDialCode);
+    return entryIndex != -1 ? dir->entries[entryIndex].id : INVALID_ENTRY_ID;
+}
+
+/**
+ * @brief Resolves an entry id in O(1).
+ *
+ * @param id An id from getEntryId() or any side structure that stored one.
+ * @param directoryIndex Receives the index of the entry's directory (may be NULL).
+ * @return The entry, or NULL if the id is invalid or its entry has been removed.
+ */
+const SpeedDialEntry *getEntryById(EntryId id, int *directoryIndex) {
+    unsigned slot = id & ((1u << ENTRY_ID_SLOT_BITS) - 1);
+    if (!manager.initialized || slot >= TOTAL_NUMBERS) {
+        return NULL;
+    }
+    const EntrySlot *entrySlot = &manager.slots[slot];
+    if (entrySlot->directoryIndex < 0 || entrySlot->generation != (id >> ENTRY_ID_SLOT_BITS)) {
+        return NULL; // Free slot, or reused by a newer entry
+    }
+    if (directoryIndex != NULL) {
+        *directoryIndex = entrySlot->directoryIndex;
+    }
+    return &manager.directories[entrySlot->directoryIndex].entries[entrySlot->entryIndex];
+}
+
+// --- Call Log ---
+
+static inline uint32_t entryIdSlot(EntryId id) {
+    return id & ((1u << ENTRY_ID_SLOT_BITS) - 1);
+}
+
+/**
+ * @brief Points the per-entry chains at the newest logged call of each live entry.
+ */
+static void rebuildCallChains() {
+    for (int i = 0; i < TOTAL_NUMBERS; i++) {
+        atomic_store(&callLog.lastCall[i], 0);
+    }
+    uint64_t head = atomic_load(&callLog.header->head);
+    uint64_t first = head > CALL_LOG_CAPACITY ? head - CALL_LOG_CAPACITY : 0;
+    for (uint64_t seq = first; seq < head; seq++) {
+        const CallRecord *record = &callLog.records[seq & (CALL_LOG_CAPACITY - 1)];
+        EntryId entry = atomic_load(&record->entry);
+        if (atomic_load(&record->sequence) == (uint32_t)(seq + 1) && entry != INVALID_ENTRY_ID) {
+            atomic_store(&callLog.lastCall[entryIdSlot(entry)], (uint32_t)(seq + 1));
+        }
+    }
+}
+
+/**
+ * @brief Points each logged call at the current entry with its directory and code hashes.
+ * Needed after a restart, when the EntryIds in the records belong to the previous run;
+ * calls to codes that are gone are kept but belong to no entry. Both hashes must match,
+ * so a code that merely collides with a logged one on hashCode() does not take its calls.
+ */
+static void reattachCallRecords() {
+    uint32_t codeHashes[MAX_DIRECTORIES][MAX_NUMBERS_PER_DIRECTORY];
+    uint32_t codeChecks[MAX_DIRECTORIES][MAX_NUMBERS_PER_DIRECTORY];
+    for (int d = 0; d < MAX_DIRECTORIES; d++) {
+        for (int i = 0; i < manager.directories[d].currentCount; i++) {
+            codeHashes[d][i] = hashCode(manager.directories[d].entries[i].speedDialCode);
+            codeChecks[d][i] = hashString(manager.directories[d].entries[i].speedDialCode);
+        }
+    }
+    uint64_t head = atomic_load(&callLog.header->head);
+    uint64_t first = head > CALL_LOG_CAPACITY ? head - CALL_LOG_CAPACITY : 0;
+    for (uint64_t seq = first; seq < head; seq++) {
+        CallRecord *record = &callLog.records[seq & (CALL_LOG_CAPACITY - 1)];
+        if (atomic_load(&record->sequence) != (uint32_t)(seq + 1) || atomic_load(&record->entry) == INVALID_ENTRY_ID) {
+            continue;
+        }
+        EntryId entry = INVALID_ENTRY_ID;
+        uint32_t dirIndex = atomic_load(&record->directoryIndex);
+        uint32_t codeHash = atomic_load(&record->codeHash);
+        uint32_t codeCheck = atomic_load(&record->codeCheck);
+        const Directory *dir = dirIndex < MAX_DIRECTORIES && manager.initialized ? &manager.directories[dirIndex] : NULL;
+        for (int i = 0; dir != NULL && i < dir->currentCount; i++) {
+            if (codeHashes[dirIndex][i] == codeHash && codeChecks[dirIndex][i] == codeCheck) {
+                entry = dir->entries[i].id;
+                break;
+            }
+        }
+        atomic_store(&record->entry, entry);
+    }
+}
+
+/**
+ * @brief Switches the call log to the in-memory ring, emptying it.
+ */
+static void useMemoryCallLog() {
+    static struct {
+        CallLogHeader header;
+        CallRecord records[CALL_LOG_CAPACITY];
+    } storage;
+    memset(&storage, 0, sizeof(storage));
+    storage.header.magic = CALL_LOG_MAGIC;
+    storage.header.capacity = CALL_LOG_CAPACITY;
+    storage.header.baseTime = (int64_t)time(NULL);
+    callLog.header = &storage.header;
+    callLog.records = storage.records;
+    callLog.mappedBytes = 0;
+    rebuildCallChains();
+}
+
+/**
+ * @brief Backs the call log with a file so calls survive restarts.
+ * An existing log is continued; a missing or foreign file is (re)initialized.
+ * Open it after loading the directories: logged calls are matched to the current
+ * entries by directory and speed dial code, as EntryIds change from run to run.
+ *
+ * @param path The call log file.
+ * @return true if the file is mapped; false if it could not be (the log is left unchanged).
+ */
+bool openCallLog(const char *path) {
+    size_t bytes = sizeof(CallLogHeader) + CALL_LOG_CAPACITY * sizeof(CallRecord);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("Failed to open call log");
+        return false;
+    }
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        perror("Failed to size call log");
+        close(fd);
+        return false;
+    }
+    void *mapped = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        perror("Failed to map call log");
+        return false;
+    }
+
+    closeCallLog();
+    callLog.header = (CallLogHeader *)mapped;
+    callLog.records = (CallRecord *)((char *)mapped + sizeof(CallLogHeader));
+    callLog.mappedBytes = bytes;
+    if (callLog.header->magic != CALL_LOG_MAGIC || callLog.header->capacity != CALL_LOG_CAPACITY) {
+        memset(mapped, 0, bytes);
+        callLog.header->magic = CALL_LOG_MAGIC;
+        callLog.header->capacity = CALL_LOG_CAPACITY;
+        callLog.header->baseTime = (int64_t)time(NULL);
+    }
+    reattachCallRecords();
+    rebuildCallChains();
+    MANAGER_LOG("Call log '%s' opened with %llu calls recorded.\n", path,
+                (unsigned long long)atomic_load(&callLog.header->head));
+    return true;
+}
+
+/**
+ * @brief Unmaps a file-backed call log and returns to an empty in-memory one.
+ */
+void closeCallLog() {
+    if (callLog.mappedBytes != 0) {
+        munmap(callLog.header, callLog.mappedBytes);
+    }
+    useMemoryCallLog();
+}
+
+/**
+ * @brief Appends a call made at a given time to the log.
+ * Lock-free: any number of threads may record at once.
+ */
+static void recordCallAt(EntryId entry, CallOutcome outcome, time_t when) {
+    if (callLog.header == NULL) {
+        useMemoryCallLog();
+    }
+    uint64_t seq = atomic_fetch_add(&callLog.header->head, 1);
+    CallRecord *record = &callLog.records[seq & (CALL_LOG_CAPACITY - 1)];
+    int64_t seconds = (int64_t)when - callLog.header->baseTime;
+    uint32_t delta = seconds > 0 ? (uint32_t)seconds : 0;
+
+    atomic_store_explicit(&record->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // Readers see the slot as in progress before any new field
+    uint32_t previous = 0;
+    int dirIndex = 0;
+    const SpeedDialEntry *dialed = entry != INVALID_ENTRY_ID ? getEntryById(entry, &dirIndex) : NULL;
+    if (dialed != NULL) {
+        previous = atomic_exchange(&callLog.lastCall[entryIdSlot(entry)], (uint32_t)(seq + 1));
+    }
+    atomic_store_explicit(&record->entry, dialed != NULL ? entry : INVALID_ENTRY_ID, memory_order_relaxed);
+    atomic_store_explicit(&record->directoryIndex, (uint32_t)dirIndex, memory_order_relaxed);
+    atomic_store_explicit(&record->codeHash, dialed != NULL ? hashCode(dialed->speedDialCode) : 0, memory_order_relaxed);
+    atomic_store_explicit(&record->codeCheck, dialed != NULL ? hashString(dialed->speedDialCode) : 0, memory_order_relaxed);
+    atomic_store_explicit(&record->previous, previous, memory_order_relaxed);
+    atomic_store_explicit(&record->timeAndOutcome, delta << 4 | (uint32_t)outcome, memory_order_relaxed);
+    atomic_store_explicit(&record->sequence, (uint32_t)(seq + 1), memory_order_release);
+}
+
+static void recordCall(EntryId entry, CallOutcome outcome) {
+    recordCallAt(entry, outcome, time(NULL));
+}
+
+/**
+ * @brief "Dials" the number stored under a speed dial code and records the call.
+ *
+ * @param directoryName The name of the directory to search within.
+ * @param speedDialCode The speed dial code to dial.
+ * @return true if a number was dialed; false if the code was not found.
+ */
+bool dialSpeedDial(const char *directoryName, const char *speedDialCode) {
+    SPEEDDIAL_PROBE(dial__entry, findDirectoryIndex(directoryName), strlen(speedDialCode));
+    uint64_t start = metricsStart();
+    bool dialed = dialSpeedDialUnprobed(directoryName, speedDialCode);
+    recordMetric(METRIC_DIAL, start, dialed);
+    SPEEDDIAL_PROBE(dial__return, findDirectoryIndex(directoryName), strlen(speedDialCode), dialed);
+    return dialed;
+}
+
+static bool dialSpeedDialUnprobed(const char *directoryName, const char *speedDialCode) {
+    TRACE_OPERATION(TRACE_DIAL, directoryName, speedDialCode, NULL);
+    // Flagged entries are dialed from their pinned copy, without the cache or a directory scan
+    int dirIndex = findDirectoryIndex(directoryName);
+    int slot = dirIndex == -1 ? -1 : findEmergencySlot(dirIndex, speedDialCode);
+    char emergencyNumber[MAX_PHONE_LENGTH];
+    EntryId emergencyId;
+    if (slot >= 0 && readEmergencyNumber(slot, emergencyNumber, &emergencyId)) {
+        recordCall(emergencyId, CALL_DIALED);
+        MANAGER_LOG("Attempting emergency dial: %s (from speed dial '%s' in '%s')\n", emergencyNumber, speedDialCode,
+                    directoryName);
+        return true;
+    }
+
+    // The lookup is part of the dial: it is not traced, counted or probed as a get of its own
+    traceInsideDial = true;
+    const char *phoneNumber = getPhoneNumberUnprobed(directoryName, speedDialCode);
+    traceInsideDial = false;
+    if (phoneNumber == NULL) {
+        recordCall(INVALID_ENTRY_ID, CALL_NOT_FOUND);
+        MANAGER_LOG("Cannot dial. Speed dial code '%s' is not assigned in '%s'.\n", speedDialCode, directoryName);
+        return false;
+    }
+    const SpeedDialEntry *entry = (const SpeedDialEntry *)(phoneNumber - offsetof(SpeedDialEntry, phoneNumber));
+    recordCall(entry->id, CALL_DIALED);
+    MANAGER_LOG("Attempting to dial: %s (from speed dial '%s' in '%s')\n", phoneNumber, speedDialCode, directoryName);
+    return true;
+}
+
+/**
+ * @brief Returns the most recent calls to a speed dial code, newest first.
+ * Follows the entry's chain of back-pointers, so the cost is proportional to
+ * maxCalls rather than to the size of the log.
+ *
+ * @param directoryName The name of the directory.
+ * @param speedDialCode The speed dial code.
+ * @param calls Receives up to maxCalls calls.
+ * @param maxCalls The capacity of calls.
+ * @return The number of calls returned, or -1 if the code does not exist.
+ */
+int getRecentCalls(const char *directoryName, const char *speedDialCode, CallLogEntry *calls, int maxCalls) {
+    EntryId id = getEntryId(directoryName, speedDialCode);
+    if (id == INVALID_ENTRY_ID) {
+        MANAGER_LOG("Speed dial code '%s' not found in '%s'. No call history.\n", speedDialCode, directoryName);
+        return -1;
+    }
+    if (callLog.header == NULL) {
+        return 0;
+    }
+
+    int found = 0;
+    uint32_t sequence = atomic_load(&callLog.lastCall[entryIdSlot(id)]);
+    while (sequence != 0 && found < maxCalls) {
+        uint64_t head = atomic_load(&callLog.header->head);
+        if ((uint32_t)head - (sequence - 1) > CALL_LOG_CAPACITY) {
+            break; // Older calls have been overwritten
+        }
+        const CallRecord *record = &callLog.records[(sequence - 1) & (CALL_LOG_CAPACITY - 1)];
+        if (atomic_load_explicit(&record->sequence, memory_order_acquire) != sequence) {
+            break;
+        }
+        EntryId entry = atomic_load_explicit(&record->entry, memory_order_relaxed);
+        uint32_t previous = atomic_load_explicit(&record->previous, memory_order_relaxed);
+        uint32_t timeAndOutcome = atomic_load_explicit(&record->timeAndOutcome, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&record->sequence, memory_order_relaxed) != sequence || entry != id) {
+            break; // Overwritten while reading, or a call to an earlier entry in the same slot
+        }
+        calls[found].timestamp = (time_t)(callLog.header->baseTime + (timeAndOutcome >> 4));
+        calls[found].outcome = (CallOutcome)(timeAndOutcome & 0xF);
+        found++;
+        sequence = previous;
+    }
+    return found;
+}
+
+// --- Emergency Fast Path ---
+
+/**
+ * @brief Finds the emergency slot of a code. Lock-free: slots are filled before
+ * emergencyCount is published and their directory and code never change.
+ * @return The slot, or -1 if the code is not flagged.
+ */
+static int findEmergencySlot(int dirIndex, const char *speedDialCode) {
+    int count = atomic_load_explicit(&manager.emergencyCount, memory_order_acquire);
+    for (int slot = 0; slot < count; slot++) {
+        const EmergencyEntry *entry = &manager.emergency[slot];
+        if (entry->directoryIndex == dirIndex && strcmp(entry->speedDialCode, speedDialCode) == 0) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Copies the number and id of an emergency slot, retrying while the writer updates it.
+ * @return true if the flagged code is currently assigned.
+ */
+static bool readEmergencyNumber(int slot, char *phoneNumber, EntryId *id) {
+    EmergencyEntry *entry = &manager.emergency[slot];
+    for (;;) {
+        uint32_t sequence = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+        if ((sequence & 1) == 0) {
+            memcpy(phoneNumber, entry->phoneNumber, MAX_PHONE_LENGTH);
+            *id = entry->id;
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&entry->sequence, memory_order_relaxed) == sequence) {
+                return phoneNumber[0] != '\0';
+            }
+        }
+        sched_yield(); // The writer is mid-update; let it finish, even under SCHED_FIFO on one core
+    }
+}
+
+/**
+ * @brief Refreshes the pinned copy of an entry after it is added or removed (no-op unless flagged).
+ */
+static void updateEmergencyEntry(int dirIndex, const SpeedDialEntry *entry, bool assigned) {
+    int slot = findEmergencySlot(dirIndex, entry->speedDialCode);
+    if (slot < 0) {
+        return;
+    }
+    EmergencyEntry *pinned = &manager.emergency[slot];
+    uint32_t sequence = atomic_load_explicit(&pinned->sequence, memory_order_relaxed);
+    atomic_store_explicit(&pinned->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    if (assigned) {
+        memcpy(pinned->phoneNumber, entry->phoneNumber, MAX_PHONE_LENGTH);
+        pinned->id = entry->id;
+    } else {
+        memset(pinned->phoneNumber, 0, MAX_PHONE_LENGTH);
+        pinned->id = INVALID_ENTRY_ID;
+    }
+    atomic_store_explicit(&pinned->sequence, sequence + 2, memory_order_release);
+}
+
+/**
+ * @brief Flags a speed dial code for the emergency fast path.
+ * Its number is kept in a pinned copy that dialSpeedDial() and getEmergencyNumber()
+ * read without locks, and the lookup server answers it ahead of all other requests.
+ * The flag follows the code, so it survives the entry being removed and re-added.
+ *
+ * @param directoryName The name of the directory.
+ * @param speedDialCode The code to flag (it need not be assigned yet).
+ * @return true if the code is flagged; false if the directory does not exist or all slots are in use.
+ */
+bool flagEmergencyEntry(const char *directoryName, const char *speedDialCode) {
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot flag emergency entry.\n", directoryName);
+        return false;
+    }
+    if (findEmergencySlot(dirIndex, speedDialCode) >= 0) {
+        return true;
+    }
+    int count = atomic_load_explicit(&manager.emergencyCount, memory_order_relaxed);
+    if (count == MAX_EMERGENCY_ENTRIES) {
+        MANAGER_LOG("Error: All %d emergency slots are in use.\n", MAX_EMERGENCY_ENTRIES);
+        return false;
+    }
+    if (count == 0 && mlock(manager.emergency, sizeof(manager.emergency)) != 0) {
+        MANAGER_LOG("Warning: Could not lock emergency entries in memory.\n");
+    }
+
+    EmergencyEntry *pinned = &manager.emergency[count];
+    memset(pinned, 0, sizeof(*pinned));
+    pinned->directoryIndex = (uint8_t)dirIndex;
+    strncpy(pinned->speedDialCode, speedDialCode, MAX_CODE_LENGTH - 1);
+    const Directory *dir = &manager.directories[dirIndex];
+    int entryIndex = findCodeIndex(dir, pinned->speedDialCode);
+    if (entryIndex != -1) {
+        memcpy(pinned->phoneNumber, dir->entries[entryIndex].phoneNumber, MAX_PHONE_LENGTH);
+        pinned->id = dir->entries[entryIndex].id;
+    }
+    atomic_store_explicit(&manager.emergencyCount, count + 1, memory_order_release);
+    MANAGER_LOG("Flagged '%s' in '%s' for emergency dialing.\n", speedDialCode, directoryName);
+    return true;
+}
+
+/**
+ * @brief Reads the number of a flagged code from its pinned copy.
+ * Lock-free and safe to call from any thread while the manager is being edited.
+ *
+ * @param directoryName The name of the directory.
+ * @param speedDialCode The flagged code.
+ * @param phoneNumber Receives the number (MAX_PHONE_LENGTH bytes).
+ * @return true if the code is flagged and assigned; false otherwise.
+ */
+bool getEmergencyNumber(const char *directoryName, const char *speedDialCode, char *phoneNumber) {
+    int dirIndex = findDirectoryIndex(directoryName);
+    int slot = dirIndex == -1 ? -1 : findEmergencySlot(dirIndex, speedDialCode);
+    EntryId id;
+    return slot >= 0 && readEmergencyNumber(slot, phoneNumber, &id);
+}
+
+// --- Real-Time Mode ---
+//
+// Lookups and dials never allocate or take locks: directories are allocated at full
+// capacity up front, and the lookup cache, call log, slot map and emergency entries
+// are fixed arrays updated with atomics. What remains unbounded is paging and
+// logging, which real-time mode removes: all memory, present and future, is locked
+// and pre-faulted, and MANAGER_LOG stops printing. Edits still print nothing but may
+// block (journal writes), so they belong on a non-real-time thread.
+
+/**
+ * @brief Touches the stack the calling thread will need, so it never faults later.
+ */
+static void prefaultStack() {
+    volatile char stack[REALTIME_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+/**
+ * @brief Prepares the manager for bounded-latency getPhoneNumber() and dialSpeedDial()
+ * calls: creates the call log if it does not exist yet, locks every page of the
+ * process in RAM (including later mappings), pre-faults the caller's stack and
+ * silences all messages. Call from the thread that will dial, after loading entries.
+ *
+ * @return true if real-time mode is on; false if the manager is not initialized
+ * or memory could not be locked (RLIMIT_MEMLOCK or CAP_IPC_LOCK).
+ */
+bool enterRealTimeMode() {
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return false;
+    }
+    if (callLog.header == NULL) {
+        useMemoryCallLog();
+    }
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        perror("Failed to lock memory for real-time mode");
+        return false;
+    }
+    prefaultStack();
+    fflush(stdout); // Nothing is printed from here on
+    manager.realTime = true;
+    return true;
+}
+
+/**
+ * @brief Unlocks memory and restores messages.
+ */
+void leaveRealTimeMode() {
+    if (manager.realTime) {
+        manager.realTime = false;
+        munlockall();
+    }
+}
+
+// --- Lookup Cache and Warming ---
+
+static inline uint32_t lookupCacheSlot(int dirIndex, uint32_t codeHash) {
+    return (codeHash ^ (uint32_t)dirIndex * 0x9E3779B1u) & (LOOKUP_CACHE_SIZE - 1);
+}
+
+/**
+ * @brief Returns the cached entry for a code, or NULL on a miss.
+ * A slot only hints at an entry: the id must still be live, in the same directory,
+ * and hold the same code, so removals and moves never return a wrong number.
+ */
+static const SpeedDialEntry *lookupCacheGet(int dirIndex, const char *speedDialCode, uint32_t codeHash) {
+    uint64_t cached = atomic_load_explicit(&manager.lookupCache[lookupCacheSlot(dirIndex, codeHash)],
+                                           memory_order_relaxed);
+    int cachedDirectory;
+    const SpeedDialEntry *entry = NULL;
+    if (cached != 0 && (uint32_t)(cached >> 32) == codeHash) {
+        entry = getEntryById((EntryId)cached, &cachedDirectory);
+        if (entry != NULL && (cachedDirectory != dirIndex || strcmp(entry->speedDialCode, speedDialCode) != 0)) {
+            entry = NULL;
+        }
+    }
+    atomic_fetch_add_explicit(entry != NULL ? &manager.lookupCacheHits : &manager.lookupCacheMisses, 1,
+                              memory_order_relaxed);
+    return entry;
+}
+
+static void lookupCachePut(int dirIndex, uint32_t codeHash, EntryId id) {
+    atomic_store_explicit(&manager.lookupCache[lookupCacheSlot(dirIndex, codeHash)],
+                          (uint64_t)codeHash << 32 | id, memory_order_relaxed);
+}
+
+/**
+ * @brief Empties the lookup cache and its counters, as after a cold start.
+ */
+void resetLookupCache() {
+    for (int i = 0; i < LOOKUP_CACHE_SIZE; i++) {
+        atomic_store(&manager.lookupCache[i], 0);
+    }
+    atomic_store(&manager.lookupCacheHits, 0);
+    atomic_store(&manager.lookupCacheMisses, 0);
+}
+
+/**
+ * @brief Reports lookup cache hits and misses since the last reset.
+ * Misses include lookups of codes that do not exist.
+ */
+void getLookupCacheStats(uint64_t *hits, uint64_t *misses) {
+    *hits = atomic_load(&manager.lookupCacheHits);
+    *misses = atomic_load(&manager.lookupCacheMisses);
+}
+
+/**
+ * @brief Rebuilds the per-hour dial counts of every entry from the call log.
+ */
+void learnDialPatterns() {
+    memset(manager.dialsByHour, 0, sizeof(manager.dialsByHour));
+    if (callLog.header == NULL) {
+        return;
+    }
+    uint64_t head = atomic_load(&callLog.header->head);
+    uint64_t first = head > CALL_LOG_CAPACITY ? head - CALL_LOG_CAPACITY : 0;
+    for (uint64_t seq = first; seq < head; seq++) {
+        const CallRecord *record = &callLog.records[seq & (CALL_LOG_CAPACITY - 1)];
+        EntryId entry = atomic_load(&record->entry);
+        if (atomic_load(&record->sequence) != (uint32_t)(seq + 1) || getEntryById(entry, NULL) == NULL) {
+            continue; // Being written, not found, or the entry has since been removed
+        }
+        time_t when = (time_t)(callLog.header->baseTime + (atomic_load(&record->timeAndOutcome) >> 4));
+        struct tm local;
+        localtime_r(&when, &local);
+        DialCount *count = &manager.dialsByHour[entryIdSlot(entry)][local.tm_hour];
+        if (*count < DIAL_COUNT_MAX) {
+            (*count)++;
+        }
+    }
+}
+
+/**
+ * @brief Fills the lookup cache with the entries most often dialed in an hour of the day
+ * and prefetches their entries, so the first dials after a cold start or an eviction hit.
+ * Call learnDialPatterns() first.
+ *
+ * @param hour The local hour of the day (0-23) to warm for.
+ * @return The number of entries warmed.
+ */
+int warmLookupCache(int hour) {
+    if (hour < 0 || hour >= HOURS_PER_DAY) {
+        return 0;
+    }
+    // Pick the busiest slots: at most LOOKUP_CACHE_SIZE, kept sorted by count
+    int top[LOOKUP_CACHE_SIZE];
+    int topCount = 0;
+    for (int slot = 0; slot < TOTAL_NUMBERS; slot++) {
+        DialCount count = manager.dialsByHour[slot][hour];
+        if (count == 0 || (topCount == LOOKUP_CACHE_SIZE && count <= manager.dialsByHour[top[topCount - 1]][hour])) {
+            continue;
+        }
+        int pos = topCount < LOOKUP_CACHE_SIZE ? topCount++ : LOOKUP_CACHE_SIZE - 1;
+        while (pos > 0 && manager.dialsByHour[top[pos - 1]][hour] < count) {
+            top[pos] = top[pos - 1];
+            pos--;
+        }
+        top[pos] = slot;
+    }
+
+    // Insert the least busy first so the busiest win any slot collisions
+    int warmed = 0;
+    for (int i = topCount - 1; i >= 0; i--) {
+        const EntrySlot *entrySlot = &manager.slots[top[i]];
+        if (entrySlot->directoryIndex < 0) {
+            continue;
+        }
+        const SpeedDialEntry *entry = &manager.directories[entrySlot->directoryIndex].entries[entrySlot->entryIndex];
+        __builtin_prefetch(entry);
+        lookupCachePut(entrySlot->directoryIndex, hashCode(entry->speedDialCode), entry->id);
+        warmed++;
+    }
+    return warmed;
+}
+
+// --- Number Portability ---
+
+/**
+ * @brief Packs the digits of a phone number into an integer, ignoring separators.
+ *
+ * @param phoneNumber The phone number string (e.g., "555-111-2222").
+ * @return The digits as an integer, or 0 if there are no digits or more than 15 of them.
+ */
+uint64_t packPhoneNumber(const char *phoneNumber) {
+    uint64_t value = 0;
+    int digits = 0;
+    for (const char *p = phoneNumber; *p != '\0'; p++) {
+        if (*p >= '0' && *p <= '9') {
+            if (++digits > 15) {
+                return 0;
+            }
+            value = value * 10 + (uint64_t)(*p - '0');
+        }
+    }
+    return value;
+}
+
+static int compareUint64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Writes a portability database file that openPortabilityDb() can map.
+ *
+ * @param path The file to create or overwrite.
+ * @param records Packed records; sorted in place before writing.
+ * @param count The number of records.
+ * @return true if the file was written completely; false otherwise.
+ */
+bool writePortabilityDb(const char *path, uint64_t *records, size_t count) {
+    qsort(records, count, sizeof(uint64_t), compareUint64);
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror("Failed to create portability database");
+        return false;
+    }
+    bool ok = fwrite(records, sizeof(uint64_t), count, file) == count;
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        MANAGER_LOG("Error: Failed to write portability database '%s'.\n", path);
+    }
+    return ok;
+}
+
+/**
+ * @brief Maps a portability database file for lookups, replacing any database already open.
+ *
+ * @param path The file written by writePortabilityDb().
+ * @return true if the database is open; false if the file is missing or malformed.
+ */
+bool openPortabilityDb(const char *path) {
+    closePortabilityDb();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open portability database");
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0 || info.st_size % sizeof(uint64_t) != 0) {
+        MANAGER_LOG("Error: Portability database '%s' is empty or malformed.\n", path);
+        close(fd);
+        return false;
+    }
+    void *mapped = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd); // The mapping keeps the file referenced
+    if (mapped == MAP_FAILED) {
+        perror("Failed to map portability database");
+        return false;
+    }
+    madvise(mapped, (size_t)info.st_size, MADV_RANDOM);
+
+    portabilityDb.records = (const uint64_t *)mapped;
+    portabilityDb.count = (size_t)info.st_size / sizeof(uint64_t);
+    portabilityDb.mappedBytes = (size_t)info.st_size;
+    MANAGER_LOG("Portability database '%s' opened with %zu entries.\n", path, portabilityDb.count);
+    return true;
+}
+
+/**
+ * @brief Unmaps the portability database, if one is open.
+ */
+void closePortabilityDb() {
+    if (portabilityDb.records != NULL) {
+        munmap((void *)portabilityDb.records, portabilityDb.mappedBytes);
+        portabilityDb.records = NULL;
+        portabilityDb.count = 0;
+        portabilityDb.mappedBytes = 0;
+    }
+}
+
+/**
+ * @brief Finds the index of the record for a number in a sorted record array.
+ * Interpolation search narrows the range while keys look evenly spread; small or skewed
+ * ranges finish with a branchless binary search so the worst case stays logarithmic.
+ *
+ * @return The record index, or -1 if the number is not present.
+ */
+static long findPortabilityRecord(const uint64_t *records, size_t count, uint64_t number) {
+    size_t lo = 0;
+    size_t hi = count; // Search range is [lo, hi)
+    for (int probes = 0; hi - lo > PORTABILITY_BINARY_CUTOFF && probes < PORTABILITY_MAX_INTERPOLATION_PROBES; probes++) {
+        uint64_t lowKey = records[lo] >> PORTABILITY_CARRIER_BITS;
+        uint64_t highKey = records[hi - 1] >> PORTABILITY_CARRIER_BITS;
+        if (number < lowKey || number > highKey) {
+            return -1;
+        }
+        if (highKey == lowKey) {
+            break;
+        }
+        size_t pos = lo + (size_t)((double)(number - lowKey) / (double)(highKey - lowKey) * (double)(hi - 1 - lo));
+        uint64_t key = records[pos] >> PORTABILITY_CARRIER_BITS;
+        if (key == number) {
+            return (long)pos;
+        }
+        if (key < number) {
+            lo = pos + 1;
+        } else {
+            hi = pos;
+        }
+    }
+
+    if (lo >= hi) {
+        return -1;
+    }
+    const uint64_t *base = records + lo;
+    size_t length = hi - lo;
+    while (length > 1) {
+        size_t half = length / 2;
+        base = ((base[half] >> PORTABILITY_CARRIER_BITS) < number) ? base + half : base; // Compiles to a cmov
+        length -= half;
+    }
+    base += (*base >> PORTABILITY_CARRIER_BITS) < number;
+    if (base < records + hi && (*base >> PORTABILITY_CARRIER_BITS) == number) {
+        return (long)(base - records);
+    }
+    return -1;
+}
+
+/**
+ * @brief Looks up the carrier a phone number has been ported to.
+ *
+ * @param phoneNumber The phone number string; separators are ignored.
+ * @param carrier Receives the carrier id if the number is ported.
+ * @return true if the number is in the portability database; false otherwise
+ * (including when no database is open).
+ */
+bool lookupPortedCarrier(const char *phoneNumber, unsigned *carrier) {
+    if (portabilityDb.records == NULL) {
+        return false;
+    }
+    uint64_t number = packPhoneNumber(phoneNumber);
+    long index = findPortabilityRecord(portabilityDb.records, portabilityDb.count, number);
+    if (index < 0) {
+        return false;
+    }
+    *carrier = (unsigned)(portabilityDb.records[index] & PORTABILITY_NO_CARRIER);
+    return true;
+}
+
+/**
+ * @brief Retrieves a phone number like getPhoneNumber(), then resolves its ported carrier.
+ *
+ * @param directoryName The name of the directory to search within.
+ * @param speedDialCode The speed dial code associated with the desired phone number.
+ * @param carrier Receives the ported carrier id, or PORTABILITY_NO_CARRIER if the number
+ * is not ported or no portability database is open.
+ * @return The phone number, or NULL if it was not found.
+ */
+const char *getPhoneNumberWithCarrier(const char *directoryName, const char *speedDialCode, unsigned *carrier) {
+    *carrier = PORTABILITY_NO_CARRIER;
+    const char *phoneNumber = getPhoneNumber(directoryName, speedDialCode);
+    if (phoneNumber != NULL && lookupPortedCarrier(phoneNumber, carrier)) {
+        MANAGER_LOG("  '%s' is ported to carrier %u.\n", phoneNumber, *carrier);
+    }
+    return phoneNumber;
+}
+
+// --- Caller-ID Enrichment ---
+
+static inline uint32_t hashPhoneKey(uint64_t number) {
+    return (uint32_t)((number * 0x9E3779B97F4A7C15ull) >> (64 - OWNER_INDEX_BITS));
+}
+
+/**
+ * @brief Rebuilds the number -> owner index from every directory.
+ * When a number appears in several directories, the first directory owns it.
+ */
+static void buildOwnerIndex() {
+    memset(manager.ownerIndex, 0, sizeof(manager.ownerIndex));
+    for (int d = 0; d < MAX_DIRECTORIES; d++) {
+        Directory *dir = &manager.directories[d];
+        for (int i = 0; i < dir->currentCount; i++) {
+            uint64_t number = packPhoneNumber(dir->entries[i].phoneNumber);
+            if (number == 0) {
+                continue; // No digits to match a calling number against
+            }
+            uint32_t slot = hashPhoneKey(number);
+            while (manager.ownerIndex[slot].number != 0 && manager.ownerIndex[slot].number != number) {
+                slot = (slot + 1) & (OWNER_INDEX_SIZE - 1);
+            }
+            if (manager.ownerIndex[slot].number == 0) {
+                manager.ownerIndex[slot].number = number;
+                manager.ownerIndex[slot].owner = dir->entries[i].id;
+            }
+        }
+    }
+    manager.ownerIndexValid = true;
+}
+
+typedef struct {
+    CallerIdRecord *records;
+    size_t count;
+    size_t matched;
+} EnrichTask;
+
+static void *enrichCallerIdRange(void *arg) {
+    EnrichTask *task = (EnrichTask *)arg;
+    const OwnerIndexSlot *index = manager.ownerIndex;
+    size_t matched = 0;
+    for (size_t i = 0; i < task->count; i++) {
+        CallerIdRecord *record = &task->records[i];
+        uint32_t slot = hashPhoneKey(record->callingNumber);
+        while (index[slot].number != 0 && index[slot].number != record->callingNumber) {
+            slot = (slot + 1) & (OWNER_INDEX_SIZE - 1);
+        }
+        bool hit = index[slot].number != 0 && record->callingNumber != 0;
+        record->owner = hit ? index[slot].owner : INVALID_ENTRY_ID;
+        matched += hit;
+    }
+    task->matched = matched;
+    return NULL;
+}
+
+/**
+ * @brief Tags each calling number in a CDR batch with the directory entry that owns it.
+ * The number -> owner index is reused across batches and rebuilt only after the
+ * directories change. The index holds at most TOTAL_NUMBERS keys, so it stays cache
+ * resident and every thread probes it directly over its own slice of the batch.
+ * Directories must not be modified while a join is running.
+ *
+ * @param records The batch; owner is filled in place.
+ * @param count The number of records in the batch.
+ * @param threads The number of worker threads (1 to MAX_JOIN_THREADS).
+ * @return The number of records that matched a directory entry.
+ */
+size_t enrichCallerIds(CallerIdRecord *records, size_t count, int threads) {
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return 0;
+    }
+    if (!manager.ownerIndexValid) {
+        buildOwnerIndex();
+    }
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > MAX_JOIN_THREADS) {
+        threads = MAX_JOIN_THREADS;
+    }
+
+    pthread_t workers[MAX_JOIN_THREADS];
+    EnrichTask tasks[MAX_JOIN_THREADS];
+    size_t chunk = (count + (size_t)threads - 1) / (size_t)threads;
+    int started = 0;
+    for (int t = 0; t < threads; t++) {
+        size_t begin = (size_t)t * chunk;
+        tasks[t].records = records + (begin < count ? begin : count);
+        tasks[t].count = begin < count ? (count - begin < chunk ? count - begin : chunk) : 0;
+        tasks[t].matched = 0;
+        if (t == threads - 1 || pthread_create(&workers[t], NULL, enrichCallerIdRange, &tasks[t]) != 0) {
+            enrichCallerIdRange(&tasks[t]); // The calling thread takes the last slice (or any that failed to start)
+        } else {
+            started |= 1 << t;
+        }
+    }
+
+    size_t matched = 0;
+    for (int t = 0; t < threads; t++) {
+        if (started & (1 << t)) {
+            pthread_join(workers[t], NULL);
+        }
+        matched += tasks[t].matched;
+    }
+    return matched;
+}
+
+// --- Directory Set Operations ---
+
+/**
+ * @brief Compares two fixed-width, zero-padded entry fields.
+ * addNumber() writes fields with strncpy, which zero-fills the tail, so whole fields
+ * can be compared 16 bytes at a time without looking for the terminator.
+ */
+static inline bool fixedFieldEquals(const char *x, const char *y, size_t width) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= width; i += 16) {
+        __m128i vx = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i vy = _mm_loadu_si128((const __m128i *)(y + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(vx, vy)) != 0xFFFF) {
+            return false;
+        }
+    }
+#endif
+    return memcmp(x + i, y + i, width - i) == 0;
+}
+
+static inline const char *setKeyField(const SpeedDialEntry *entry, SetKey key) {
+    return key == SET_KEY_CODE ? entry->speedDialCode : entry->phoneNumber;
+}
+
+static inline size_t setKeyWidth(SetKey key) {
+    return key == SET_KEY_CODE ? MAX_CODE_LENGTH : MAX_PHONE_LENGTH;
+}
+
+static void buildSetProbe(uint16_t *probe, const Directory *dir, SetKey key) {
+    memset(probe, 0, SET_PROBE_SIZE * sizeof(uint16_t));
+    for (int i = 0; i < dir->currentCount; i++) {
+        uint32_t slot = hashString(setKeyField(&dir->entries[i], key)) & (SET_PROBE_SIZE - 1);
+        while (probe[slot] != 0) {
+            slot = (slot + 1) & (SET_PROBE_SIZE - 1);
+        }
+        probe[slot] = (uint16_t)(i + 1);
+    }
+}
+
+/**
+ * @brief Finds a zero-padded field in a probe built by buildSetProbe().
+ * @return The index of the first entry with that field, or -1 if there is none.
+ */
+static int setProbeFind(const uint16_t *probe, const Directory *dir, SetKey key, const char *field) {
+    size_t width = setKeyWidth(key);
+    uint32_t slot = hashString(field) & (SET_PROBE_SIZE - 1);
+    while (probe[slot] != 0) {
+        if (fixedFieldEquals(setKeyField(&dir->entries[probe[slot] - 1], key), field, width)) {
+            return probe[slot] - 1;
+        }
+        slot = (slot + 1) & (SET_PROBE_SIZE - 1);
+    }
+    return -1;
+}
+
+static bool setProbeContains(const uint16_t *probe, const Directory *dir, SetKey key, const char *field) {
+    return setProbeFind(probe, dir, key, field) != -1;
+}
+
+/**
+ * @brief Prepares an iterator over the union, intersection or difference of two directories.
+ * Results are produced one at a time by nextSetResult(); codes are unique within a
+ * directory, while numbers may repeat, so each matching entry of A is reported.
+ *
+ * @param it The iterator to initialize.
+ * @param directoryA The name of the left-hand directory.
+ * @param directoryB The name of the right-hand directory.
+ * @param operation The set operation to apply.
+ * @param key Whether entries are matched by speed dial code or by phone number.
+ * @return true if the iterator is ready; false if either directory does not exist.
+ */
+bool beginDirectorySetOperation(DirectorySetIterator *it, const char *directoryA, const char *directoryB,
+                                SetOperation operation, SetKey key) {
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return false;
+    }
+    int indexA = findDirectoryIndex(directoryA);
+    int indexB = findDirectoryIndex(directoryB);
+    if (indexA == -1 || indexB == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot compare directories.\n",
+                    indexA == -1 ? directoryA : directoryB);
+        return false;
+    }
+
+    it->a = &manager.directories[indexA];
+    it->b = &manager.directories[indexB];
+    it->operation = operation;
+    it->key = key;
+    it->phase = 0;
+    it->position = 0;
+    buildSetProbe(it->probeB, it->b, key);
+    if (operation == SET_UNION) {
+        buildSetProbe(it->probeA, it->a, key);
+    }
+    return true;
+}
+
+/**
+ * @brief Advances a set operation iterator.
+ *
+ * @param it An iterator prepared by beginDirectorySetOperation().
+ * @return The next entry in the result, or NULL when the result is exhausted.
+ */
+const SpeedDialEntry *nextSetResult(DirectorySetIterator *it) {
+    if (it->phase == 0) {
+        while (it->position < it->a->currentCount) {
+            const SpeedDialEntry *entry = &it->a->entries[it->position++];
+            if (it->operation == SET_UNION) {
+                return entry;
+            }
+            bool inB = setProbeContains(it->probeB, it->b, it->key, setKeyField(entry, it->key));
+            if (inB == (it->operation == SET_INTERSECTION)) {
+                return entry;
+            }
+        }
+        if (it->operation != SET_UNION) {
+            return NULL;
+        }
+        it->phase = 1;
+        it->position = 0;
+    }
+    while (it->position < it->b->currentCount) {
+        const SpeedDialEntry *entry = &it->b->entries[it->position++];
+        if (!setProbeContains(it->probeA, it->a, it->key, setKeyField(entry, it->key))) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// --- Sorted Listing and Export ---
+
+static int compareStringPointers(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static void insertionSortStrings(const char **keys, size_t count, size_t depth) {
+    for (size_t i = 1; i < count; i++) {
+        const char *key = keys[i];
+        size_t j = i;
+        while (j > 0 && strcmp(keys[j - 1] + depth, key + depth) > 0) {
+            keys[j] = keys[j - 1];
+            j--;
+        }
+        keys[j] = key;
+    }
+}
+
+/**
+ * @brief Partitions keys in place by their byte at depth (American flag sort).
+ * Each key's byte is read once into digits (a scratch array parallel to keys), so the
+ * permutation cycles touch only the two arrays and never the string text.
+ * @param bucketStart Receives the first index of each of the 256 buckets, plus the end.
+ * @return false if every key fell into the same bucket (nothing was moved).
+ */
+static bool partitionStringsByByte(const char **keys, uint8_t *digits, size_t count, size_t depth,
+                                   size_t bucketStart[257]) {
+    size_t counts[256] = {0};
+    for (size_t i = 0; i < count; i++) {
+        digits[i] = (uint8_t)keys[i][depth];
+        counts[digits[i]]++;
+    }
+    if (counts[digits[0]] == count) {
+        return false;
+    }
+    size_t next[256];
+    bucketStart[0] = 0;
+    for (int b = 0; b < 256; b++) {
+        next[b] = bucketStart[b];
+        bucketStart[b + 1] = bucketStart[b] + counts[b];
+    }
+    for (int b = 0; b < 256; b++) {
+        while (next[b] < bucketStart[b + 1]) {
+            const char *key = keys[next[b]];
+            uint8_t digit = digits[next[b]];
+            while (digit != b) {
+                // Swap the key into its bucket and keep placing whatever it displaced
+                size_t slot = next[digit]++;
+                const char *displacedKey = keys[slot];
+                uint8_t displacedDigit = digits[slot];
+                keys[slot] = key;
+                digits[slot] = digit;
+                key = displacedKey;
+                digit = displacedDigit;
+            }
+            keys[next[b]] = key;
+            digits[next[b]++] = digit;
+        }
+    }
+    return true;
+}
+
+static void msdRadixSortStrings(const char **keys, uint8_t *digits, size_t count, size_t depth) {
+    size_t bucketStart[257];
+    for (;;) {
+        if (count < RADIX_INSERTION_CUTOFF) {
+            insertionSortStrings(keys, count, depth);
+            return;
+        }
+        if (partitionStringsByByte(keys, digits, count, depth, bucketStart)) {
+            break;
+        }
+        if (digits[0] == 0) {
+            return; // Every key ends here, so they are all equal
+        }
+        depth++; // Shared byte (e.g., a common "contact" prefix): move on without recursing
+    }
+    // Bucket 0 holds strings that end at this depth; they are all equal
+    for (int b = 1; b < 256; b++) {
+        size_t size = bucketStart[b + 1] - bucketStart[b];
+        if (size > 1) {
+            msdRadixSortStrings(keys + bucketStart[b], digits + bucketStart[b], size, depth + 1);
+        }
+    }
+}
+
+typedef struct {
+    const char **keys;
+    uint8_t *digits;
+    const size_t *bucketStart;
+    size_t depth; // Depth the top-level buckets were partitioned at
+    atomic_int nextBucket;
+} RadixSortJob;
+
+static void *radixSortBucketWorker(void *arg) {
+    RadixSortJob *job = (RadixSortJob *)arg;
+    for (int b; (b = atomic_fetch_add(&job->nextBucket, 1)) < 256;) {
+        size_t begin = job->bucketStart[b];
+        size_t size = job->bucketStart[b + 1] - begin;
+        if (b > 0 && size > 1) {
+            msdRadixSortStrings(job->keys + begin, job->digits + begin, size, job->depth + 1);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Sorts NUL-terminated strings in place with an MSD radix sort.
+ * The first byte that differs between keys partitions them into 256 buckets, which
+ * worker threads then sort independently; buckets below RADIX_INSERTION_CUTOFF use
+ * insertion sort. Needs one scratch byte per key.
+ *
+ * @param keys The strings to sort (the pointers are permuted, not the text).
+ * @param count The number of strings.
+ * @param threads The number of threads to use for the top-level buckets (1 to MAX_SORT_THREADS).
+ */
+void radixSortStrings(const char **keys, size_t count, int threads) {
+    uint8_t stackDigits[MAX_NUMBERS_PER_DIRECTORY]; // Directory-sized sorts need no allocation
+    uint8_t *digits = count <= MAX_NUMBERS_PER_DIRECTORY ? stackDigits : (uint8_t *)malloc(count);
+    if (digits == NULL) {
+        qsort(keys, count, sizeof(char *), compareStringPointers);
+        return;
+    }
+
+    if (threads <= 1 || count < 65536) {
+        msdRadixSortStrings(keys, digits, count, 0);
+        if (digits != stackDigits) {
+            free(digits);
+        }
+        return;
+    }
+    if (threads > MAX_SORT_THREADS) {
+        threads = MAX_SORT_THREADS;
+    }
+
+    size_t bucketStart[257];
+    size_t depth = 0;
+    while (!partitionStringsByByte(keys, digits, count, depth, bucketStart)) {
+        if (digits[0] == 0) {
+            free(digits);
+            return; // All keys are equal
+        }
+        depth++;
+    }
+    RadixSortJob job = {keys, digits, bucketStart, depth, 0};
+    pthread_t workers[MAX_SORT_THREADS];
+    int started = 0;
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&workers[started], NULL, radixSortBucketWorker, &job) == 0) {
+            started++;
+        }
+    }
+    radixSortBucketWorker(&job);
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    free(digits);
+}
+
+/**
+ * @brief Fills order with the entries of a directory sorted by speed dial code.
+ * The code is the first member of SpeedDialEntry, so a sorted code pointer is
+ * also a pointer to its entry.
+ */
+static void sortDirectoryEntries(const Directory *dir, const SpeedDialEntry **order) {
+    _Static_assert(offsetof(SpeedDialEntry, speedDialCode) == 0, "code must be the first entry field");
+    const char **keys = (const char **)order;
+    for (int i = 0; i < dir->currentCount; i++) {
+        keys[i] = dir->entries[i].speedDialCode;
+    }
+    radixSortStrings(keys, (size_t)dir->currentCount, 1);
+}
+
+/**
+ * @brief Lists all speed dial entries in a given directory, ordered by speed dial code.
+ *
+ * @param directoryName The name of the directory to list entries from.
+ */
+void listNumbersInDirectorySorted(const char *directoryName) {
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return;
+    }
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot list numbers.\n", directoryName);
+        return;
+    }
+
+    Directory *dir = &manager.directories[dirIndex];
+    const SpeedDialEntry *order[MAX_NUMBERS_PER_DIRECTORY];
+    sortDirectoryEntries(dir, order);
+
+    printf("\n--- Listing numbers in '%s' by code (%d/%d) ---\n",
+           directoryName, dir->currentCount, MAX_NUMBERS_PER_DIRECTORY);
+    if (dir->currentCount == 0) {
+        printf("  Directory is empty.\n");
+    } else {
+        for (int i = 0; i < dir->currentCount; i++) {
+            printf("  %s: %s\n", order[i]->speedDialCode, order[i]->phoneNumber);
+        }
+    }
+}
+
+/**
+ * @brief Writes a directory as "code,number" lines ordered by speed dial code.
+ *
+ * @param directoryName The name of the directory to export.
+ * @param out The stream to write to.
+ * @return true if every line was written; false if the directory does not exist or a write failed.
+ */
+bool exportDirectory(const char *directoryName, FILE *out) {
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return false;
+    }
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot export numbers.\n", directoryName);
+        return false;
+    }
+
+    Directory *dir = &manager.directories[dirIndex];
+    const SpeedDialEntry *order[MAX_NUMBERS_PER_DIRECTORY];
+    sortDirectoryEntries(dir, order);
+    for (int i = 0; i < dir->currentCount; i++) {
+        if (fprintf(out, "%s,%s\n", order[i]->speedDialCode, order[i]->phoneNumber) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- Predicate Scans ---
+
+/**
+ * @brief Finds a code in a directory.
+ * A code that fits a short key is matched against the code column, which holds every
+ * code's first SHORT_KEY_LENGTH bytes zero padded: two word compares per row, plus the
+ * stored length to tell a code of exactly SHORT_KEY_LENGTH bytes from longer codes
+ * sharing those bytes. Longer codes are compared as strings.
+ *
+ * @return The index of the entry, or -1 if the code is not in the directory.
+ */
+static int findCodeIndex(const Directory *dir, const char *speedDialCode) {
+    const DirectoryColumns *columns = dir->columns;
+    ShortKey key;
+    int length = makeShortKey(speedDialCode, &key);
+    if (length < 0) {
+        for (int i = 0; i < dir->currentCount; i++) {
+            if (columns->codeLength[i] > SHORT_KEY_LENGTH && strcmp(dir->entries[i].speedDialCode, speedDialCode) == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    for (int i = 0; i < dir->currentCount; i++) {
+        ShortKey stored;
+        memcpy(stored.word, columns->codePrefix[i], SHORT_KEY_LENGTH);
+        if (stored.word[0] == key.word[0] && stored.word[1] == key.word[1] &&
+            (length < SHORT_KEY_LENGTH || columns->codeLength[i] == SHORT_KEY_LENGTH)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Copies entries[index] into row index of the directory's scan columns.
+ */
+static void setScanColumns(Directory *dir, int index) {
+    DirectoryColumns *columns = dir->columns;
+    const SpeedDialEntry *entry = &dir->entries[index];
+    columns->codeLength[index] = (uint8_t)strlen(entry->speedDialCode);
+    size_t prefixLength =
+        columns->codeLength[index] < SCAN_CODE_PREFIX_WIDTH ? columns->codeLength[index] : SCAN_CODE_PREFIX_WIDTH;
+    memcpy(columns->codePrefix[index], entry->speedDialCode, prefixLength);
+    memset(columns->codePrefix[index] + prefixLength, 0, SCAN_CODE_PREFIX_WIDTH - prefixLength);
+    setScanNumberColumns(dir, index);
+}
+
+/**
+ * @brief Copies the number of entries[index] into its scan columns, leaving the code columns as they are.
+ */
+static void setScanNumberColumns(Directory *dir, int index) {
+    DirectoryColumns *columns = dir->columns;
+    const SpeedDialEntry *entry = &dir->entries[index];
+    columns->numberLength[index] = (uint8_t)strlen(entry->phoneNumber);
+    memcpy(columns->number[index], entry->phoneNumber, columns->numberLength[index]);
+    memset(columns->number[index] + columns->numberLength[index], 0, SCAN_NUMBER_WIDTH - columns->numberLength[index]);
+}
+
+/**
+ * @brief Closes the gap left in the scan columns by removing row index.
+ * Call before decrementing currentCount.
+ */
+static void removeScanColumns(Directory *dir, int index) {
+    DirectoryColumns *columns = dir->columns;
+    size_t tail = (size_t)(dir->currentCount - 1 - index);
+    memmove(&columns->codeLength[index], &columns->codeLength[index + 1], tail);
+    memmove(&columns->numberLength[index], &columns->numberLength[index + 1], tail);
+    memmove(columns->codePrefix[index], columns->codePrefix[index + 1], tail * SCAN_CODE_PREFIX_WIDTH);
+    memmove(columns->number[index], columns->number[index + 1], tail * SCAN_NUMBER_WIDTH);
+}
+
+/**
+ * @brief Copies row from of the directory's scan columns to row to.
+ */
+static void moveScanColumns(Directory *dir, int from, int to) {
+    DirectoryColumns *columns = dir->columns;
+    columns->codeLength[to] = columns->codeLength[from];
+    columns->numberLength[to] = columns->numberLength[from];
+    memcpy(columns->codePrefix[to], columns->codePrefix[from], SCAN_CODE_PREFIX_WIDTH);
+    memcpy(columns->number[to], columns->number[from], SCAN_NUMBER_WIDTH);
+}
+
+/**
+ * @brief Evaluates one predicate for up to 16 consecutive rows starting at base.
+ * @return A mask with bit j set if row base + j matches.
+ */
+static uint32_t evaluateScanBlock(const Directory *dir, const ScanPredicate *predicate, int base, int rows) {
+    const DirectoryColumns *columns = dir->columns;
+    uint32_t mask = 0;
+    switch (predicate->type) {
+    case SCAN_CODE_LONGER_THAN:
+    case SCAN_NUMBER_LONGER_THAN: {
+        const uint8_t *lengths = predicate->type == SCAN_CODE_LONGER_THAN ? columns->codeLength : columns->numberLength;
+        if (predicate->length < 0) {
+            return (1u << rows) - 1; // Every length is longer
+        }
+        if (predicate->length >= 127) {
+            return 0; // Stored lengths are below 128
+        }
+#ifdef __SSE2__
+        if (rows == 16) {
+            // Stored lengths and the (now 0..126) threshold are below 128, so a signed byte compare is exact
+            __m128i v = _mm_loadu_si128((const __m128i *)(lengths + base));
+            return (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)predicate->length)));
+        }
+#endif
+        for (int j = 0; j < rows; j++) {
+            mask |= (uint32_t)(lengths[base + j] > predicate->length) << j;
+        }
+        return mask;
+    }
+    case SCAN_CODE_PREFIX:
+    case SCAN_NUMBER_PREFIX: {
+        bool code = predicate->type == SCAN_CODE_PREFIX;
+        size_t prefixLength = strlen(predicate->text);
+        if (code && prefixLength > SCAN_CODE_PREFIX_WIDTH) {
+            // Longer than the code column: compare against the entries themselves
+            for (int j = 0; j < rows; j++) {
+                mask |= (uint32_t)(strncmp(dir->entries[base + j].speedDialCode, predicate->text, prefixLength) == 0) << j;
+            }
+            return mask;
+        }
+        if (prefixLength > MAX_PHONE_LENGTH) {
+            return 0; // No stored number can be that long
+        }
+#ifdef __SSE2__
+        if (prefixLength <= 16) {
+            char padded[16] = {0};
+            memcpy(padded, predicate->text, prefixLength);
+            __m128i prefix = _mm_loadu_si128((const __m128i *)padded);
+            uint32_t want = (1u << prefixLength) - 1;
+            for (int j = 0; j < rows; j++) {
+                const char *text = code ? columns->codePrefix[base + j] : columns->number[base + j];
+                __m128i v = _mm_loadu_si128((const __m128i *)text);
+                uint32_t equal = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, prefix));
+                mask |= (uint32_t)((equal & want) == want) << j;
+            }
+            return mask;
+        }
+#endif
+        for (int j = 0; j < rows; j++) {
+            const char *text = code ? columns->codePrefix[base + j] : columns->number[base + j];
+            mask |= (uint32_t)(memcmp(text, predicate->text, prefixLength) == 0) << j;
+        }
+        return mask;
+    }
+    case SCAN_NUMBER_DIGITS_ONLY:
+        for (int j = 0; j < rows; j++) {
+            const char *text = columns->number[base + j];
+            bool digitsOnly;
+#ifdef __SSE2__
+            // A byte passes if it is '0'..'9' or the zero padding after the number
+            __m128i zero = _mm_setzero_si128();
+            __m128i nine = _mm_set1_epi8(9);
+            __m128i ok = _mm_set1_epi8(-1);
+            for (int k = 0; k < SCAN_NUMBER_WIDTH; k += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(text + k));
+                __m128i digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+                ok = _mm_and_si128(ok, _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(digit, nine), nine), _mm_cmpeq_epi8(v, zero)));
+            }
+            digitsOnly = _mm_movemask_epi8(ok) == 0xFFFF;
+#else
+            digitsOnly = true;
+            for (int k = 0; k < columns->numberLength[base + j]; k++) {
+                digitsOnly &= text[k] >= '0' && text[k] <= '9';
+            }
+#endif
+            mask |= (uint32_t)(digitsOnly && columns->numberLength[base + j] > 0) << j;
+        }
+        return mask;
+    }
+    return 0;
+}
+
+typedef struct {
+    const ScanPredicate *predicates;
+    int predicateCount;
+    int firstDirectory;
+    int lastDirectory;
+    atomic_int nextDirectory;
+    EntryId results[MAX_DIRECTORIES][MAX_NUMBERS_PER_DIRECTORY];
+    int resultCount[MAX_DIRECTORIES];
+} ScanJob;
+
+static void *scanDirectoryWorker(void *arg) {
+    ScanJob *job = (ScanJob *)arg;
+    for (int d; (d = job->firstDirectory + atomic_fetch_add(&job->nextDirectory, 1)) <= job->lastDirectory;) {
+        const Directory *dir = &manager.directories[d];
+        int found = 0;
+        for (int base = 0; base < dir->currentCount; base += 16) {
+            int rows = dir->currentCount - base < 16 ? dir->currentCount - base : 16;
+            uint32_t mask = (1u << rows) - 1;
+            for (int p = 0; p < job->predicateCount && mask != 0; p++) {
+                mask &= evaluateScanBlock(dir, &job->predicates[p], base, rows);
+            }
+            while (mask != 0) {
+                int j = __builtin_ctz(mask);
+                job->results[d][found++] = dir->entries[base + j].id;
+                mask &= mask - 1;
+            }
+        }
+        job->resultCount[d] = found;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Finds the entries that satisfy every predicate in a range of directories.
+ * Predicates run over the directories' scan columns 16 rows at a time, and
+ * directories are spread across worker threads. Matching entry ids are returned in
+ * directory order, then entry order. Directories must not change during a scan.
+ *
+ * @param predicates The predicates to AND together (none matches every entry).
+ * @param predicateCount The number of predicates.
+ * @param firstDirectory The index of the first directory to scan (0 for "Directory 1").
+ * @param lastDirectory The index of the last directory to scan, inclusive.
+ * @param matches Receives up to maxMatches matches.
+ * @param maxMatches The capacity of matches.
+ * @param threads The number of threads to use (1 to MAX_DIRECTORIES).
+ * @return The total number of matching entries, which may exceed maxMatches.
+ */
+size_t scanEntries(const ScanPredicate *predicates, int predicateCount, int firstDirectory, int lastDirectory,
+                   EntryId *matches, size_t maxMatches, int threads) {
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return 0;
+    }
+    if (firstDirectory < 0 || lastDirectory >= MAX_DIRECTORIES || firstDirectory > lastDirectory) {
+        MANAGER_LOG("Error: Invalid directory range %d..%d for scan.\n", firstDirectory, lastDirectory);
+        return 0;
+    }
+
+    ScanJob *job = (ScanJob *)malloc(sizeof(ScanJob));
+    if (job == NULL) {
+        perror("Failed to allocate scan results");
+        return 0;
+    }
+    job->predicates = predicates;
+    job->predicateCount = predicateCount;
+    job->firstDirectory = firstDirectory;
+    job->lastDirectory = lastDirectory;
+    atomic_init(&job->nextDirectory, 0);
+
+    pthread_t workers[MAX_DIRECTORIES];
+    int started = 0;
+    for (int t = 1; t < threads && t <= lastDirectory - firstDirectory; t++) {
+        if (pthread_create(&workers[started], NULL, scanDirectoryWorker, job) == 0) {
+            started++;
+        }
+    }
+    scanDirectoryWorker(job);
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+
+    size_t total = 0;
+    for (int d = firstDirectory; d <= lastDirectory; d++) {
+        for (int i = 0; i < job->resultCount[d]; i++, total++) {
+            if (total < maxMatches) {
+                matches[total] = job->results[d][i];
+            }
+        }
+    }
+    free(job);
+    return total;
+}
+
+// --- Capacity Statistics ---
+
+/**
+ * @brief Returns the counter of the prefix extended by one digit.
+ */
+static inline int prefixCounterChild(int counter, int digit) {
+    return counter * 10 + 1 + digit;
+}
+
+/**
+ * @brief Counts a number in (delta = +1) or out of (delta = -1) the totals and prefix counters.
+ * Only digits are considered, so "+44 20..." and "44-20..." share prefixes.
+ * Counts are atomic, so editors on different threads can update them together.
+ */
+static void updatePrefixStats(int dirIndex, const char *phoneNumber, int delta) {
+    manager.totalCount += delta;
+    int counter = 0;
+    manager.prefixStats[0].total += delta;
+    manager.prefixStats[0].count[dirIndex] += delta;
+    int depth = 0;
+    for (const char *p = phoneNumber; *p != '\0' && depth < PREFIX_STATS_DEPTH; p++) {
+        if (*p < '0' || *p > '9') {
+            continue;
+        }
+        counter = prefixCounterChild(counter, *p - '0');
+        manager.prefixStats[counter].total += delta;
+        manager.prefixStats[counter].count[dirIndex] += delta;
+        depth++;
+    }
+}
+
+/**
+ * @brief Sets the planned capacity a directory's fill ratio is measured against.
+ * The quota is for reporting only; addNumber() still accepts up to MAX_NUMBERS_PER_DIRECTORY.
+ *
+ * @param directoryName The name of the directory.
+ * @param quota The planned number of entries (must be positive).
+ * @return true if the quota was set; false if the directory does not exist or the quota is invalid.
+ */
+bool setDirectoryQuota(const char *directoryName, int quota) {
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1 || quota <= 0) {
+        MANAGER_LOG("Error: Cannot set quota %d on directory '%s'.\n", quota, directoryName);
+        return false;
+    }
+    manager.directories[dirIndex].quota = quota;
+    return true;
+}
+
+/**
+ * @brief Reports a directory's entry count and fill ratio against its quota in O(1).
+ *
+ * @param directoryName The name of the directory.
+ * @param stats Receives the statistics.
+ * @return true on success; false if the directory does not exist.
+ */
+bool getDirectoryStats(const char *directoryName, DirectoryStats *stats) {
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot report statistics.\n", directoryName);
+        return false;
+    }
+    const Directory *dir = &manager.directories[dirIndex];
+    stats->count = dir->currentCount;
+    stats->quota = dir->quota;
+    stats->fillRatio = (double)dir->currentCount / (double)dir->quota;
+    return true;
+}
+
+/**
+ * @brief Counts the numbers starting with a digit prefix, without scanning entries.
+ *
+ * @param prefix Up to PREFIX_STATS_DEPTH digits (e.g., "44"); separators are ignored.
+ * @param directoryName The directory to count in, or NULL for all directories.
+ * @return The number of matching entries, or -1 if the prefix is too long or the directory does not exist.
+ */
+int getPrefixCount(const char *prefix, const char *directoryName) {
+    int dirIndex = -1;
+    if (directoryName != NULL && (dirIndex = findDirectoryIndex(directoryName)) == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot report statistics.\n", directoryName);
+        return -1;
+    }
+    int counter = 0;
+    int depth = 0;
+    for (const char *p = prefix; *p != '\0'; p++) {
+        if (*p < '0' || *p > '9') {
+            continue;
+        }
+        if (++depth > PREFIX_STATS_DEPTH) {
+            return -1;
+        }
+        counter = prefixCounterChild(counter, *p - '0');
+    }
+    return dirIndex == -1 ? manager.prefixStats[counter].total : manager.prefixStats[counter].count[dirIndex];
+}
+
+/**
+ * @brief Prints per-directory occupancy and the most common leading digits.
+ */
+void printCapacityReport() {
+    printf("\n--- Capacity report (%d/%d numbers) ---\n", manager.totalCount, TOTAL_NUMBERS);
+    for (int i = 0; i < MAX_DIRECTORIES; i++) {
+        DirectoryStats stats;
+        getDirectoryStats(manager.directories[i].name, &stats);
+        printf("  %-12s %4d/%-4d (%5.1f%%)\n", manager.directories[i].name, stats.count, stats.quota,
+               stats.fillRatio * 100.0);
+    }
+    for (int digit = 0; digit < 10; digit++) {
+        int counter = prefixCounterChild(0, digit);
+        if (manager.prefixStats[counter].total > 0) {
+            printf("  prefix %d: %d numbers\n", digit, manager.prefixStats[counter].total);
+        }
+    }
+}
+
+/**
+ * @brief Lists the memory each component of the manager occupies in this build
+ * configuration, whether or not it is in use. Sizes are fixed at compile time.
+ * @return The number of components written to parts (at most 12), the last being "other".
+ */
+static int getFootprint(MemoryComponent *parts) {
+    const MemoryComponent components[] = {
+        {"entries", sizeof(SpeedDialEntry) * MAX_NUMBERS_PER_DIRECTORY * MAX_DIRECTORIES},
+        {"scan columns", sizeof(DirectoryColumns) * MAX_DIRECTORIES},
+        {"owner index", sizeof(manager.ownerIndex)},
+        {"prefix statistics", sizeof(manager.prefixStats)},
+        {"entry slot map", sizeof(manager.slots)},
+        {"lookup cache", sizeof(manager.lookupCache)},
+        {"dial patterns", sizeof(manager.dialsByHour)},
+        {"emergency entries", sizeof(manager.emergency)},
+        {"call log", sizeof(CallLog) + sizeof(CallLogHeader) + sizeof(CallRecord) * CALL_LOG_CAPACITY},
+        {"change feed", sizeof(changeFeed)},
+        {"rate limits", sizeof(rateLimits)},
+    };
+    size_t total = sizeof(manager) + sizeof(CallLog) + sizeof(CallLogHeader) + sizeof(CallRecord) * CALL_LOG_CAPACITY +
+                   sizeof(changeFeed) + sizeof(rateLimits) + (sizeof(SpeedDialEntry) * MAX_NUMBERS_PER_DIRECTORY +
+                   sizeof(DirectoryColumns)) * MAX_DIRECTORIES;
+    int count = 0;
+    for (size_t i = 0; i < sizeof(components) / sizeof(components[0]); i++) {
+        parts[count++] = components[i];
+        total -= components[i].bytes;
+    }
+    parts[count++] = (MemoryComponent){"other", total};
+    return count;
+}
+
+/**
+ * @brief Prints the memory each component of the manager occupies in this build configuration.
+ */
+void printFootprintReport() {
+    MemoryComponent parts[12];
+    int count = getFootprint(parts);
+    size_t total = 0;
+
+    printf("\n--- Memory footprint (%d numbers, %s storage) ---\n", TOTAL_NUMBERS,
+#ifdef SPEEDDIAL_STATIC_STORAGE
+           "static"
+#else
+           "heap"
+#endif
+    );
+    printf("  entry size: %zu bytes (code %d, number %d)\n", sizeof(SpeedDialEntry), MAX_CODE_LENGTH, MAX_PHONE_LENGTH);
+    for (int i = 0; i < count; i++) {
+        printf("  %-18s %8zu bytes\n", parts[i].component, parts[i].bytes);
+        total += parts[i].bytes;
+    }
+    printf("  %-18s %8zu bytes (%.1f KB)\n", "total", total, (double)total / 1024.0);
+}
+
+/**
+ * @brief The bytes the allocator actually reserved for a block, which may exceed the request.
+ */
+static size_t allocatedSize(const void *block, size_t requested) {
+#if defined(__GLIBC__) && !defined(SPEEDDIAL_STATIC_STORAGE)
+    (void)requested;
+    return block != NULL ? malloc_usable_size((void *)block) : 0;
+#else
+    (void)block;
+    return requested; // Static tables are exactly their size
+#endif
+}
+
+/**
+ * @brief Breaks down the memory one directory costs. Only its own two blocks (entries
+ * and scan columns) are measured through the allocator, which is where slack comes
+ * from; the index and cache figures are computed from the sizes of the slots the
+ * directory occupies in tables shared by all directories.
+ *
+ * @param directoryName The directory to measure.
+ * @param memory Receives the breakdown.
+ * @return true if the directory exists; false otherwise.
+ */
+bool getDirectoryMemory(const char *directoryName, DirectoryMemory *memory) {
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1) {
+        MANAGER_LOG("Error: Directory '%s' does not exist. Cannot report memory.\n", directoryName);
+        return false;
+    }
+    const Directory *dir = &manager.directories[dirIndex];
+    memset(memory, 0, sizeof(*memory));
+
+    for (int i = 0; i < dir->currentCount; i++) {
+        memory->strings += strlen(dir->entries[i].speedDialCode) + strlen(dir->entries[i].phoneNumber) + 2;
+    }
+    size_t records = (size_t)dir->currentCount * sizeof(SpeedDialEntry);
+    memory->entries = records - memory->strings;
+    size_t columnRow = sizeof(dir->columns->codeLength[0]) + sizeof(dir->columns->numberLength[0]) +
+                       sizeof(dir->columns->codePrefix[0]) + sizeof(dir->columns->number[0]);
+    size_t columnRows = (size_t)dir->currentCount * columnRow;
+    memory->indexes = columnRows + (size_t)dir->currentCount * sizeof(EntrySlot) +
+                      PREFIX_STATS_COUNTERS * sizeof(manager.prefixStats[0].count[0]);
+    memory->slack = allocatedSize(dir->entries, sizeof(SpeedDialEntry) * MAX_NUMBERS_PER_DIRECTORY) - records +
+                    allocatedSize(dir->columns, sizeof(DirectoryColumns)) - columnRows;
+
+    int owner;
+    for (int i = 0; manager.ownerIndexValid && i < OWNER_INDEX_SIZE; i++) {
+        if (manager.ownerIndex[i].number != 0 && getEntryById(manager.ownerIndex[i].owner, &owner) != NULL &&
+            owner == dirIndex) {
+            memory->indexes += sizeof(OwnerIndexSlot);
+        }
+    }
+    for (int i = 0; i < LOOKUP_CACHE_SIZE; i++) {
+        uint64_t cached = atomic_load_explicit(&manager.lookupCache[i], memory_order_relaxed);
+        if (cached != 0 && getEntryById((EntryId)cached, &owner) != NULL && owner == dirIndex) {
+            memory->caches += sizeof(manager.lookupCache[0]);
+        }
+    }
+    memory->caches += (size_t)dir->currentCount * sizeof(manager.dialsByHour[0]);
+    for (int i = 0; i < atomic_load(&manager.emergencyCount); i++) {
+        if (manager.emergency[i].directoryIndex == dirIndex) {
+            memory->caches += sizeof(EmergencyEntry);
+        }
+    }
+    memory->total = memory->entries + memory->strings + memory->indexes + memory->caches + memory->slack;
+    return true;
+}
+
+/**
+ * @brief Prints what each directory costs and how much of it is slack.
+ */
+void printDirectoryMemoryReport() {
+    printf("\n--- Directory memory (bytes) ---\n");
+    printf("  %-12s %8s %8s %8s %8s %8s %8s %6s\n", "directory", "entries", "strings", "indexes", "caches", "slack",
+           "total", "slack%");
+    for (int i = 0; i < MAX_DIRECTORIES; i++) {
+        DirectoryMemory memory;
+        getDirectoryMemory(manager.directories[i].name, &memory);
+        printf("  %-12s %8zu %8zu %8zu %8zu %8zu %8zu %5.1f%%\n", manager.directories[i].name, memory.entries,
+               memory.strings, memory.indexes, memory.caches, memory.slack, memory.total,
+               memory.total > 0 ? (double)memory.slack * 100.0 / (double)memory.total : 0.0);
+    }
+}
+
+// --- Change Feed ---
+
+/**
+ * @brief Opens (or creates) the journal that keeps every change event.
+ * An existing journal is continued: new events are numbered after its last one.
+ * Open the journal before making changes that followers need to replay.
+ *
+ * @param path The journal file.
+ * @return true if the journal is open; false otherwise.
+ */
+bool openChangeJournal(const char *path) {
+    closeChangeJournal();
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("Failed to open change journal");
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        perror("Failed to read change journal");
+        close(fd);
+        return false;
+    }
+    uint64_t events = (uint64_t)info.st_size / sizeof(ChangeEvent);
+
+    // Writes are appended in sequence order, so a crash can only tear the last one (at most
+    // one transaction long): cut it at its first missing event, then drop an unfinished transaction
+    uint64_t complete = events;
+    ChangeEvent event;
+    for (uint64_t i = events > 2 * MAX_TRANSACTION_MOVES ? events - 2 * MAX_TRANSACTION_MOVES : 0; i < events; i++) {
+        if (pread(fd, &event, sizeof(event), (off_t)(i * sizeof(ChangeEvent))) != (ssize_t)sizeof(event) ||
+            event.sequence != i + 1) {
+            complete = i;
+            break;
+        }
+    }
+    while (complete > 0 &&
+           pread(fd, &event, sizeof(event), (off_t)((complete - 1) * sizeof(ChangeEvent))) == (ssize_t)sizeof(event) &&
+           event.transactionRemaining != 0) {
+        complete--;
+    }
+    if (complete * sizeof(ChangeEvent) != (uint64_t)info.st_size) {
+        if (ftruncate(fd, (off_t)(complete * sizeof(ChangeEvent))) != 0) {
+            perror("Failed to repair change journal");
+            close(fd);
+            return false;
+        }
+        MANAGER_LOG("Change journal '%s': dropped %llu events of an unfinished write.\n", path,
+                    (unsigned long long)(events - complete));
+        events = complete;
+    }
+    if (events > atomic_load(&changeFeed.head)) {
+        atomic_store(&changeFeed.reserved, events);
+        atomic_store(&changeFeed.head, events);
+    }
+    changeFeed.journalFd = fd;
+    MANAGER_LOG("Change journal '%s' opened with %llu events.\n", path, (unsigned long long)events);
+    return true;
+}
+
+/**
+ * @brief Closes the change journal; older events are then only available from memory.
+ */
+void closeChangeJournal() {
+    if (changeFeed.journalFd >= 0) {
+        close(changeFeed.journalFd);
+        changeFeed.journalFd = -1;
+    }
+}
+
+/**
+ * @brief Writes consecutive events to their fixed position in the journal with one write.
+ */
+static bool commitJournalRecord(const ChangeEvent *events, int count) {
+    SPEEDDIAL_PROBE(journal__commit__entry, events[0].sequence, count);
+    off_t offset = (off_t)((events[0].sequence - 1) * sizeof(ChangeEvent));
+    size_t bytes = (size_t)count * sizeof(ChangeEvent);
+    if (pwrite(changeFeed.journalFd, events, bytes, offset) != (ssize_t)bytes) {
+        perror("Failed to write change journal");
+        SPEEDDIAL_PROBE(journal__commit__return, events[0].sequence, 0);
+        return false;
+    }
+    SPEEDDIAL_PROBE(journal__commit__return, events[0].sequence, 1);
+    return true;
+}
+
+/**
+ * @brief Publishes consecutive events to the in-memory ring and the journal.
+ * Editors on several threads each claim the next run of sequences and fill in their
+ * ring slots, then take turns in sequence order to write the journal and publish,
+ * so the journal only ever grows at its end and a crash cannot leave a hole in it.
+ */
+static void publishEvents(ChangeEvent *events, int count) {
+    uint64_t first = atomic_fetch_add_explicit(&changeFeed.reserved, (uint64_t)count, memory_order_relaxed) + 1;
+    for (int i = 0; i < count; i++) {
+        uint64_t sequence = first + (uint64_t)i;
+        size_t slot = (size_t)(sequence - 1) & (CHANGE_FEED_CAPACITY - 1);
+        events[i].sequence = sequence;
+        events[i].transactionRemaining = (uint16_t)(count - 1 - i);
+        atomic_store_explicit(&changeFeed.ringSequence[slot], 0, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        changeFeed.ring[slot] = events[i];
+        atomic_store_explicit(&changeFeed.ringSequence[slot], sequence, memory_order_release);
+    }
+
+    while (atomic_load_explicit(&changeFeed.head, memory_order_acquire) != first - 1) {
+        sched_yield(); // An editor with an earlier sequence is still publishing its events
+    }
+    if (changeFeed.journalFd >= 0) {
+        commitJournalRecord(events, count);
+    }
+    atomic_store_explicit(&changeFeed.head, first + (uint64_t)count - 1, memory_order_release);
+}
+
+/**
+ * @brief Publishes a change, or adds it to the calling thread's open transaction.
+ * Called after a change has been applied.
+ */
+static void publishChange(ChangeType type, int dirIndex, const SpeedDialEntry *entry) {
+    ChangeEvent event;
+    memset(&event, 0, sizeof(ChangeEvent)); // Zero padding keeps journal bytes deterministic
+    event.type = (uint8_t)type;
+    event.directoryIndex = (uint8_t)dirIndex;
+    event.id = entry->id;
+    memcpy(event.speedDialCode, entry->speedDialCode, MAX_CODE_LENGTH);
+    memcpy(event.phoneNumber, entry->phoneNumber, MAX_PHONE_LENGTH);
+    if (openTransaction != NULL) {
+        openTransaction->events[openTransaction->count++] = event;
+        return;
+    }
+    publishEvents(&event, 1);
+}
+
+/**
+ * @brief Creates a cursor for a new follower.
+ *
+ * @param fromStart true to replay all retained history; false to see only future changes.
+ * @return The cursor to pass to readChanges().
+ */
+ChangeCursor subscribeChanges(bool fromStart) {
+    ChangeCursor cursor;
+    cursor.nextSequence = fromStart ? 1 : atomic_load(&changeFeed.head) + 1;
+    return cursor;
+}
+
+/**
+ * @brief Reads the next batch of changes for a follower and advances its cursor.
+ * Recent events come from memory; older ones are read from the journal, so a
+ * follower that saved its cursor can resume after a restart.
+ *
+ * @param cursor The follower's cursor.
+ * @param events Receives up to maxEvents events, oldest first.
+ * @param maxEvents The capacity of events.
+ * @return The number of events read (0 if the follower is current), or -1 if the
+ * cursor is older than the retained history and the follower must resynchronize.
+ */
+int readChanges(ChangeCursor *cursor, ChangeEvent *events, int maxEvents) {
+    uint64_t head = atomic_load_explicit(&changeFeed.head, memory_order_acquire);
+    int count = 0;
+    while (count < maxEvents && cursor->nextSequence <= head) {
+        uint64_t sequence = cursor->nextSequence;
+        bool copied = false;
+        if (head - sequence < CHANGE_FEED_CAPACITY) {
+            size_t slot = (size_t)(sequence - 1) & (CHANGE_FEED_CAPACITY - 1);
+            if (atomic_load_explicit(&changeFeed.ringSequence[slot], memory_order_acquire) == sequence) {
+                events[count] = changeFeed.ring[slot];
+                atomic_thread_fence(memory_order_acquire);
+                copied = atomic_load_explicit(&changeFeed.ringSequence[slot], memory_order_relaxed) == sequence;
+            }
+        }
+        if (!copied) {
+            off_t offset = (off_t)((sequence - 1) * sizeof(ChangeEvent));
+            if (changeFeed.journalFd < 0 ||
+                pread(changeFeed.journalFd, &events[count], sizeof(ChangeEvent), offset) != (ssize_t)sizeof(ChangeEvent) ||
+                events[count].sequence != sequence) {
+                if (count == 0) {
+                    MANAGER_LOG("Error: Change %llu is no longer retained. Follower must resynchronize.\n",
+                                (unsigned long long)sequence);
+                    return -1;
+                }
+                break;
+            }
+        }
+        count++;
+        cursor->nextSequence++;
+    }
+    return count;
+}
+
+// --- Transactions ---
+
+/**
+ * @brief Moves entries between directories as one transaction: all of them or none.
+ *
+ * Every move is checked before anything changes (the code is in its source directory,
+ * not already in its target unless that entry is leaving in the same transaction, and
+ * every target has room), so a rejected transaction leaves no trace. The moved entries
+ * are then claimed in slot order, so concurrent editors of them wait or fail fast, and
+ * their removal and addition events are published together and written to the journal
+ * with one write. Followers see the whole transaction or none of it.
+ *
+ * Moved entries keep their EntryId, version and call history. Like adds and removes,
+ * transactions shift the entries left behind, so they run on the single writer thread
+ * while no other thread looks up or edits: a lookup running alongside could find a
+ * code's old index and read the neighbour that slid into it.
+ *
+ * @return true if the transaction committed; false if any move was invalid.
+ */
+static bool commitMoves(const EntryMove *moves, int count) {
+    SPEEDDIAL_PROBE(transaction__entry, count);
+    if (!manager.initialized) {
+        MANAGER_LOG("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+        return false;
+    }
+    if (count < 1 || count > MAX_TRANSACTION_MOVES) {
+        MANAGER_LOG("Error: A transaction moves 1 to %d entries, not %d.\n", MAX_TRANSACTION_MOVES, count);
+        return false;
+    }
+
+    // Find every entry and check the moves against the directories as they will be
+    EntryId ids[MAX_TRANSACTION_MOVES];
+    int finalCount[MAX_DIRECTORIES];
+    for (int d = 0; d < MAX_DIRECTORIES; d++) {
+        finalCount[d] = manager.directories[d].currentCount;
+    }
+    for (int k = 0; k < count; k++) {
+        const EntryMove *move = &moves[k];
+        const Directory *from = &manager.directories[move->fromDirectory];
+        int entryIndex = findCodeIndex(from, move->speedDialCode);
+        if (move->fromDirectory == move->toDirectory || entryIndex == -1) {
+            MANAGER_LOG("Error: Cannot move '%s' from '%s' to '%s'. Transaction not committed.\n",
+                        move->speedDialCode, from->name, manager.directories[move->toDirectory].name);
+            return false;
+        }
+        ids[k] = from->entries[entryIndex].id;
+        finalCount[move->fromDirectory]--;
+        finalCount[move->toDirectory]++;
+    }
+    for (int k = 0; k < count; k++) {
+        const EntryMove *move = &moves[k];
+        const Directory *to = &manager.directories[move->toDirectory];
+        int existing = findCodeIndex(to, move->speedDialCode);
+        bool clash = finalCount[move->toDirectory] > MAX_NUMBERS_PER_DIRECTORY;
+        for (int j = 0; j < count && !clash; j++) {
+            if (j == k) {
+                continue;
+            }
+            if (existing != -1 && ids[j] == to->entries[existing].id) {
+                existing = -1; // The entry holding the code is leaving
+            }
+            clash = ids[j] == ids[k] || (moves[j].toDirectory == move->toDirectory &&
+                                         strcmp(moves[j].speedDialCode, move->speedDialCode) == 0);
+        }
+        if (clash || existing != -1) {
+            MANAGER_LOG("Error: '%s' cannot join '%s' (duplicate code or no room). Transaction not committed.\n",
+                        move->speedDialCode, to->name);
+            return false;
+        }
+    }
+
+    // Claim the entries in slot order, so two transactions can never wait on each other
+    int order[MAX_TRANSACTION_MOVES];
+    uint32_t versions[MAX_TRANSACTION_MOVES];
+    for (int k = 0; k < count; k++) {
+        int pos = k;
+        uint32_t slot = ids[k] & ((1u << ENTRY_ID_SLOT_BITS) - 1);
+        while (pos > 0 && (ids[order[pos - 1]] & ((1u << ENTRY_ID_SLOT_BITS) - 1)) > slot) {
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+        order[pos] = k;
+    }
+    for (int k = 0; k < count; k++) {
+        versions[order[k]] = claimEntry(ids[order[k]]);
+    }
+
+    // Take every entry out, then put each into its new directory
+    ChangeTransaction transaction;
+    transaction.count = 0;
+    openTransaction = &transaction;
+    SpeedDialEntry moved[MAX_TRANSACTION_MOVES];
+    for (int k = 0; k < count; k++) {
+        EntrySlot *slot = &manager.slots[ids[k] & ((1u << ENTRY_ID_SLOT_BITS) - 1)];
+        Directory *from = &manager.directories[moves[k].fromDirectory];
+        moved[k] = from->entries[slot->entryIndex];
+        TRACE_OPERATION(TRACE_REMOVE, from->name, moved[k].speedDialCode, NULL);
+        updatePrefixStats(moves[k].fromDirectory, moved[k].phoneNumber, -1);
+        publishChange(CHANGE_REMOVE, moves[k].fromDirectory, &moved[k]);
+        updateEmergencyEntry(moves[k].fromDirectory, &moved[k], false);
+        closeEntryGap(from, slot->entryIndex);
+    }
+    for (int k = 0; k < count; k++) {
+        EntrySlot *slot = &manager.slots[ids[k] & ((1u << ENTRY_ID_SLOT_BITS) - 1)];
+        Directory *to = &manager.directories[moves[k].toDirectory];
+        TRACE_OPERATION(TRACE_ADD, to->name, moved[k].speedDialCode, moved[k].phoneNumber);
+        to->entries[to->currentCount] = moved[k];
+        slot->directoryIndex = (int16_t)moves[k].toDirectory;
+        slot->entryIndex = (int16_t)to->currentCount;
+        setScanColumns(to, to->currentCount);
+        updatePrefixStats(moves[k].toDirectory, moved[k].phoneNumber, +1);
+        publishChange(CHANGE_ADD, moves[k].toDirectory, &moved[k]);
+        updateEmergencyEntry(moves[k].toDirectory, &moved[k], true);
+        to->currentCount++;
+    }
+    openTransaction = NULL;
+    publishEvents(transaction.events, transaction.count);
+    manager.ownerIndexValid = false;
+
+    for (int k = 0; k < count; k++) {
+        releaseEntry(ids[k], versions[k]); // A move leaves the number, and so the version, as it was
+    }
+    SPEEDDIAL_PROBE(transaction__return, count, 1);
+    return true;
+}
+
+/**
+ * @brief Resolves the directories of a transaction, logging the first unknown name.
+ * @return true if every name was found.
+ */
+static bool findTransactionDirectories(const char *const *names, int *indexes, int count) {
+    for (int i = 0; i < count; i++) {
+        indexes[i] = findDirectoryIndex(names[i]);
+        if (indexes[i] == -1) {
+            MANAGER_LOG("Error: Directory '%s' does not exist. Transaction not committed.\n", names[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Moves an entry to another directory atomically, keeping its EntryId and call history.
+ *
+ * @param fromDirectory The name of the directory holding the entry.
+ * @param toDirectory The name of the directory to move it to.
+ * @param speedDialCode The speed dial code of the entry.
+ * @return true if the entry moved; false if a directory or the code does not exist,
+ * the target already has the code, or the target is full.
+ */
+bool moveNumber(const char *fromDirectory, const char *toDirectory, const char *speedDialCode) {
+    const char *names[] = {fromDirectory, toDirectory};
+    int indexes[2];
+    if (!findTransactionDirectories(names, indexes, 2)) {
+        return false;
+    }
+    EntryMove move = {speedDialCode, indexes[0], indexes[1]};
+    if (!commitMoves(&move, 1)) {
+        return false;
+    }
+    MANAGER_LOG("Successfully moved '%s' from '%s' to '%s'.\n", speedDialCode, fromDirectory, toDirectory);
+    return true;
+}
+
+/**
+ * @brief Exchanges two entries between directories atomically: each goes to the other's directory.
+ *
+ * @param directoryA The name of the directory holding the first entry.
+ * @param speedDialCodeA The speed dial code of the first entry.
+ * @param directoryB The name of the (different) directory holding the second entry.
+ * @param speedDialCodeB The speed dial code of the second entry.
+ * @return true if the entries were swapped; false if either is missing or its code
+ * is already taken in the other directory.
+ */
+bool swapNumbers(const char *directoryA, const char *speedDialCodeA, const char *directoryB, const char *speedDialCodeB) {
+    const char *names[] = {directoryA, directoryB};
+    int indexes[2];
+    if (!findTransactionDirectories(names, indexes, 2)) {
+        return false;
+    }
+    EntryMove moves[] = {{speedDialCodeA, indexes[0], indexes[1]}, {speedDialCodeB, indexes[1], indexes[0]}};
+    if (!commitMoves(moves, 2)) {
+        return false;
+    }
+    MANAGER_LOG("Successfully swapped '%s' in '%s' with '%s' in '%s'.\n", speedDialCodeA, directoryA, speedDialCodeB,
+                directoryB);
+    return true;
+}
+
+/**
+ * @brief Moves many entries from one directory to another in a single transaction.
+ *
+ * @param fromDirectory The name of the directory holding the entries.
+ * @param toDirectory The name of the directory to move them to.
+ * @param speedDialCodes The codes of the entries to move.
+ * @param count The number of codes, at most MAX_TRANSACTION_MOVES.
+ * @return true if every entry moved; false (and none moved) otherwise.
+ */
+bool reassignNumbers(const char *fromDirectory, const char *toDirectory, const char *const *speedDialCodes, int count) {
+    const char *names[] = {fromDirectory, toDirectory};
+    int indexes[2];
+    if (!findTransactionDirectories(names, indexes, 2)) {
+        return false;
+    }
+    EntryMove moves[MAX_TRANSACTION_MOVES];
+    for (int k = 0; k < count && k < MAX_TRANSACTION_MOVES; k++) {
+        moves[k] = (EntryMove){speedDialCodes[k], indexes[0], indexes[1]};
+    }
+    if (!commitMoves(moves, count)) {
+        return false;
+    }
+    MANAGER_LOG("Successfully moved %d entries from '%s' to '%s'.\n", count, fromDirectory, toDirectory);
+    return true;
+}
+
+// --- Lookup Server ---
+//
+// The server speaks a line protocol over a local (Unix domain) stream socket.
+// Fields are separated by tabs, since directory names contain spaces.
+//
+//   GET <directory> <code>          -> OK <number> | NOTFOUND
+//   ADD <directory> <code> <number> -> OK | ERR <reason>
+//   SET <directory> <code> <number> -> OK | ERR <reason>  (adds the code, or changes its number)
+//   VER <directory> <code>          -> OK <version> | NOTFOUND
+//   CAS <directory> <code> <version> <number> -> OK <new version> | CONFLICT <version> | NOTFOUND
+//   DEL <directory> <code>          -> OK | ERR <reason>
+//   MOVE <directory> <code> <to directory>                 -> OK | ERR <reason>
+//   SWAP <directory> <code> <other directory> <other code> -> OK | ERR <reason>  (both or neither move)
+//   LIST <directory>                -> ENTRY <code> <number> ... END
+//   SUB                             -> OK, then INV <directory> <code> after every change
+//
+// FLUSH tells subscribers to drop their whole cache (sent if invalidations were lost,
+// including those a subscriber missed by not reading them fast enough).
+// Any request may instead be answered BUSY when its tenant is over its rate limit
+// or the server is shedding load.
+//
+// Waiting requests run in priority lanes (see RequestClass): GETs of emergency
+// entries first, then other GETs, then edits, then listings. A connection's own
+// requests always run in the order it sent them, so a client that must never wait
+// behind a listing should dial on a connection of its own. Listings are sent a few
+// lines per pass of the event loop, so other lanes run between the pieces; an entry
+// changed while its directory is being listed may be listed twice or not at all,
+// and the INV lines that follow tell a subscriber which ones.
+
+static volatile bool serverStopping;
+static int metricsListener = -1; // Set by listenForMetrics()
+static int serverLoad; // Requests handled in the previous pass of the event loop
+
+/**
+ * @brief Formats a protocol line, truncating it to fit and adding the newline.
+ * @return The line's length including the newline, or -1 on a formatting error.
+ */
+static int formatLine(char line[SERVER_LINE_LENGTH * 2], const char *format, va_list args) {
+    int length = vsnprintf(line, SERVER_LINE_LENGTH * 2 - 1, format, args);
+    if (length < 0) {
+        return -1;
+    }
+    if (length > SERVER_LINE_LENGTH * 2 - 2) {
+        length = SERVER_LINE_LENGTH * 2 - 2;
+    }
+    line[length++] = '\n';
+    return length;
+}
+
+/**
+ * @brief Sends a line on a blocking socket (the client side of the protocol).
+ */
+static void sendLine(int fd, const char *format, ...) {
+    char line[SERVER_LINE_LENGTH * 2];
+    va_list args;
+    va_start(args, format);
+    int length = formatLine(line, format, args);
+    va_end(args);
+    for (int sent = 0; sent < length;) {
+        ssize_t n = send(fd, line + sent, (size_t)(length - sent), MSG_NOSIGNAL);
+        if (n <= 0) {
+            return; // The connection is closed; poll() will report it
+        }
+        sent += (int)n;
+    }
+}
+
+/**
+ * @brief Hands a connection's queued bytes to its socket, as many as it takes without blocking.
+ * Once a subscriber's backlog has drained enough, the FLUSH it is owed is queued.
+ */
+static void flushOutbox(ServerConnection *connection) {
+    size_t sent = 0;
+    while (sent < connection->outboxLength) {
+        ssize_t n = send(connection->fd, connection->outbox + sent, connection->outboxLength - sent,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n <= 0) {
+            break; // The socket is full (poll() will say when it drains) or closed (poll() reports that too)
+        }
+        sent += (size_t)n;
+    }
+    connection->outboxLength -= sent;
+    memmove(connection->outbox, connection->outbox + sent, connection->outboxLength);
+    if (connection->flushOwed && SERVER_OUTBOX_LENGTH - connection->outboxLength >= SERVER_REPLY_ROOM) {
+        memcpy(connection->outbox + connection->outboxLength, "FLUSH\n", 6);
+        connection->outboxLength += 6;
+        connection->flushOwed = false;
+        flushOutbox(connection);
+    }
+}
+
+/**
+ * @brief Queues a line for a connection and sends what the socket will take now.
+ * The server never blocks on a client: a client that stops reading fills its outbox instead.
+ *
+ * @return true if the line was queued; false if the outbox had no room for it.
+ */
+static bool queueLine(ServerConnection *connection, const char *format, ...) {
+    char line[SERVER_LINE_LENGTH * 2];
+    va_list args;
+    va_start(args, format);
+    int length = formatLine(line, format, args);
+    va_end(args);
+    if (length < 0 || (size_t)length > SERVER_OUTBOX_LENGTH - connection->outboxLength) {
+        return false;
+    }
+    memcpy(connection->outbox + connection->outboxLength, line, (size_t)length);
+    connection->outboxLength += (size_t)length;
+    flushOutbox(connection);
+    return true;
+}
+
+/**
+ * @brief Splits a line into tab-separated fields in place.
+ * @return The number of fields.
+ */
+static int splitFields(char *line, char **fields, int maxFields) {
+    int count = 0;
+    fields[count++] = line;
+    for (char *p = line; *p != '\0' && count < maxFields; p++) {
+        if (*p == '\t') {
+            *p = '\0';
+            fields[count++] = p + 1;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Classifies a request line (fields already split) for scheduling and admission.
+ * SUB and malformed requests are cheap and share the dial lane.
+ */
+static RequestClass classifyServerRequest(char **fields, int count) {
+    if (strcmp(fields[0], "GET") == 0) {
+        int dirIndex = count == 3 ? findDirectoryIndex(fields[1]) : -1;
+        return dirIndex != -1 && findEmergencySlot(dirIndex, fields[2]) >= 0 ? REQUEST_EMERGENCY : REQUEST_DIAL;
+    } else if (strcmp(fields[0], "LIST") == 0) {
+        return REQUEST_BULK;
+    } else if (strcmp(fields[0], "ADD") == 0 || strcmp(fields[0], "SET") == 0 || strcmp(fields[0], "DEL") == 0 ||
+               strcmp(fields[0], "CAS") == 0 || strcmp(fields[0], "MOVE") == 0 || strcmp(fields[0], "SWAP") == 0) {
+        return REQUEST_EDIT;
+    }
+    return REQUEST_DIAL;
+}
+
+/**
+ * @brief Returns the lane of the first complete request in a connection's inbox.
+ * @return The request's class, or -1 if no complete request is waiting or there is no room to answer it.
+ */
+static int nextRequestLane(const ServerConnection *connection) {
+    if (connection->fd < 0 || SERVER_OUTBOX_LENGTH - connection->outboxLength < SERVER_REPLY_ROOM) {
+        return -1; // Gone, or not reading its replies: its requests wait until it does
+    }
+    if (connection->listDirectory >= 0) {
+        return REQUEST_BULK; // The rest of a listing comes before the connection's next request
+    }
+    const char *newline = memchr(connection->inbox, '\n', connection->inboxLength);
+    if (newline == NULL) {
+        return -1;
+    }
+    char line[SERVER_LINE_LENGTH];
+    memcpy(line, connection->inbox, (size_t)(newline - connection->inbox));
+    line[newline - connection->inbox] = '\0';
+    char *fields[5];
+    int count = splitFields(line, fields, 5);
+    return (int)classifyServerRequest(fields, count);
+}
+
+/**
+ * @brief Decides whether the server takes a request: bulk work is shed first as load
+ * rises, edits next, dials never; then the tenant's rate limit for the class applies.
+ */
+static bool admitServerRequest(RequestClass requestClass, const char *directoryName) {
+    if (requestClass == REQUEST_EMERGENCY) {
+        return true;
+    }
+    if ((requestClass == REQUEST_BULK && serverLoad > SHED_BULK_LOAD) ||
+        (requestClass == REQUEST_EDIT && serverLoad > SHED_EDIT_LOAD)) {
+        atomic_fetch_add_explicit(&rejectedRequests[requestClass], 1, memory_order_relaxed);
+        return false;
+    }
+    int dirIndex = directoryName != NULL ? findDirectoryIndex(directoryName) : -1;
+    return dirIndex == -1 || admitRequest(dirIndex, requestClass);
+}
+
+static void handleServerRequest(ServerConnection *connection, char *line) {
+    char *fields[5];
+    int count = splitFields(line, fields, 5);
+    RequestClass requestClass = classifyServerRequest(fields, count);
+
+    if (!admitServerRequest(requestClass, count > 1 ? fields[1] : NULL)) {
+        queueLine(connection, "BUSY");
+        return;
+    }
+
+    if (requestClass == REQUEST_EMERGENCY) {
+        char phoneNumber[MAX_PHONE_LENGTH];
+        if (getEmergencyNumber(fields[1], fields[2], phoneNumber)) {
+            queueLine(connection, "OK\t%s", phoneNumber);
+        } else {
+            queueLine(connection, "NOTFOUND");
+        }
+    } else if (strcmp(fields[0], "GET") == 0 && count == 3) {
+        const char *phoneNumber = getPhoneNumber(fields[1], fields[2]);
+        if (phoneNumber != NULL) {
+            queueLine(connection, "OK\t%s", phoneNumber);
+        } else {
+            queueLine(connection, "NOTFOUND");
+        }
+    } else if (strcmp(fields[0], "ADD") == 0 && count == 4) {
+        queueLine(connection, addNumber(fields[1], fields[2], fields[3]) ? "OK" : "ERR\tnot added");
+    } else if (strcmp(fields[0], "SET") == 0 && count == 4) {
+        queueLine(connection, upsertNumber(fields[1], fields[2], fields[3]) ? "OK" : "ERR\tnot set");
+    } else if (strcmp(fields[0], "VER") == 0 && count == 3) {
+        uint32_t version = getEntryVersion(fields[1], fields[2]);
+        if (version != 0) {
+            queueLine(connection, "OK\t%u", version);
+        } else {
+            queueLine(connection, "NOTFOUND");
+        }
+    } else if (strcmp(fields[0], "CAS") == 0 && count == 5) {
+        uint32_t expectedVersion = (uint32_t)strtoul(fields[3], NULL, 10);
+        if (casNumber(fields[1], fields[2], expectedVersion, fields[4])) {
+            queueLine(connection, "OK\t%u", expectedVersion + 1);
+        } else {
+            uint32_t version = getEntryVersion(fields[1], fields[2]);
+            if (version != 0) {
+                queueLine(connection, "CONFLICT\t%u", version);
+            } else {
+                queueLine(connection, "NOTFOUND");
+            }
+        }
+    } else if (strcmp(fields[0], "DEL") == 0 && count == 3) {
+        queueLine(connection, removeNumber(fields[1], fields[2]) ? "OK" : "ERR\tnot removed");
+    } else if (strcmp(fields[0], "MOVE") == 0 && count == 4) {
+        queueLine(connection, moveNumber(fields[1], fields[3], fields[2]) ? "OK" : "ERR\tnot moved");
+    } else if (strcmp(fields[0], "SWAP") == 0 && count == 5) {
+        queueLine(connection, swapNumbers(fields[1], fields[2], fields[3], fields[4]) ? "OK" : "ERR\tnot swapped");
+    } else if (strcmp(fields[0], "LIST") == 0 && count == 2) {
+        int dirIndex = findDirectoryIndex(fields[1]);
+        if (dirIndex == -1) {
+            queueLine(connection, "ERR\tno such directory");
+            return;
+        }
+        connection->listDirectory = dirIndex; // Sent by continueListing()
+        connection->listNext = 0;
+    } else if (strcmp(fields[0], "SUB") == 0 && count == 1) {
+        connection->subscribed = true;
+        queueLine(connection, "OK");
+    } else {
+        queueLine(connection, "ERR\tbad request");
+    }
+}
+
+/**
+ * @brief Sends the next LIST_LINES_PER_PASS lines of a connection's listing.
+ */
+static void continueListing(ServerConnection *connection) {
+    const Directory *dir = &manager.directories[connection->listDirectory];
+    for (int sent = 0; sent < LIST_LINES_PER_PASS; sent++) {
+        if (connection->listNext >= dir->currentCount) {
+            queueLine(connection, "END");
+            connection->listDirectory = -1;
+            return;
+        }
+        const SpeedDialEntry *entry = &dir->entries[connection->listNext++];
+        queueLine(connection, "ENTRY\t%s\t%s", entry->speedDialCode, entry->phoneNumber);
+    }
+}
+
+/**
+ * @brief Runs the complete requests waiting in the connections' inboxes, highest lane
+ * first, so an emergency dial never waits for more than one piece of a listing.
+ * Listings get one piece of LIST_LINES_PER_PASS lines per call; the rest wait.
+ *
+ * @param connections The server's connections.
+ * @param rotation Where to start looking among equal lanes, so no connection is starved.
+ * @return The number of requests run.
+ */
+static int runServerRequests(ServerConnection *connections, int rotation) {
+    int lanes[MAX_SERVER_CLIENTS];
+    for (int c = 0; c < MAX_SERVER_CLIENTS; c++) {
+        lanes[c] = nextRequestLane(&connections[c]);
+    }
+    bool bulkRan = false;
+    int handled = 0;
+    for (;;) {
+        int best = -1;
+        for (int i = 0; i < MAX_SERVER_CLIENTS; i++) {
+            int c = (rotation + i) % MAX_SERVER_CLIENTS;
+            if (lanes[c] < 0 || (lanes[c] == REQUEST_BULK && bulkRan)) {
+                continue;
+            }
+            if (best == -1 || lanes[c] < lanes[best]) {
+                best = c;
+            }
+        }
+        if (best == -1) {
+            return handled;
+        }
+
+        ServerConnection *connection = &connections[best];
+        if (connection->listDirectory < 0) {
+            char *newline = memchr(connection->inbox, '\n', connection->inboxLength);
+            *newline = '\0';
+            handleServerRequest(connection, connection->inbox);
+            connection->inboxLength -= (size_t)(newline + 1 - connection->inbox);
+            memmove(connection->inbox, newline + 1, connection->inboxLength);
+            handled++;
+        }
+        if (connection->listDirectory >= 0 && !bulkRan) {
+            continueListing(connection);
+            bulkRan = true;
+        }
+        bulkRan |= lanes[best] == REQUEST_BULK;
+        lanes[best] = nextRequestLane(connection);
+    }
+}
+
+/**
+ * @brief Queues an INV line for every subscriber for each change since the last call.
+ * A subscriber whose outbox is full misses the INV lines and is owed a FLUSH instead,
+ * so one that stops reading costs the server a bounded outbox, never a stall.
+ */
+static void pushInvalidations(ServerConnection *connections, ChangeCursor *cursor) {
+    ChangeEvent events[64];
+    int count;
+    while ((count = readChanges(cursor, events, 64)) != 0) {
+        for (int c = 0; c < MAX_SERVER_CLIENTS; c++) {
+            ServerConnection *connection = &connections[c];
+            if (connection->fd < 0 || !connection->subscribed) {
+                continue;
+            }
+            if (count < 0) {
+                connection->flushOwed = true;
+                flushOutbox(connection);
+                continue;
+            }
+            for (int i = 0; i < count && !connection->flushOwed; i++) {
+                // Leave reply room, so a lagging subscriber's own requests are still answered
+                connection->flushOwed = SERVER_OUTBOX_LENGTH - connection->outboxLength < SERVER_REPLY_ROOM ||
+                                        !queueLine(connection, "INV\t%s\t%s",
+                                                   manager.directories[events[i].directoryIndex].name,
+                                                   events[i].speedDialCode);
+            }
+        }
+        if (count < 0) {
+            *cursor = subscribeChanges(false);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Ends a metrics scrape and frees its slot.
+ */
+static void closeMetricsConnection(MetricsConnection *scrape) {
+    close(scrape->fd);
+    free(scrape->response);
+    scrape->fd = -1;
+    scrape->response = NULL;
+}
+
+/**
+ * @brief Takes a waiting scrape off the metrics listener, if a slot is free.
+ */
+static void acceptMetricsConnection(MetricsConnection *scrapes) {
+    int s = 0;
+    while (s < MAX_METRICS_CONNECTIONS && scrapes[s].fd >= 0) {
+        s++;
+    }
+    if (s == MAX_METRICS_CONNECTIONS) {
+        return; // Every slot is busy: the scrape waits in the backlog
+    }
+    int fd = accept(metricsListener, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    scrapes[s] = (MetricsConnection){fd, NULL, 0, 0, nowNanoseconds() + METRICS_SCRAPE_TIMEOUT};
+}
+
+/**
+ * @brief Moves a metrics scrape along without blocking: reads its request, then sends
+ * as much of the page as the socket takes. Any path is accepted, as the only thing
+ * served is the metrics page. A scrape that is not done by its deadline is dropped,
+ * so a silent or slow scraper costs a slot, never lookup latency.
+ */
+static void serveMetricsConnection(MetricsConnection *scrape, short revents) {
+    if (scrape->response == NULL && (revents & (POLLIN | POLLHUP | POLLERR))) {
+        char request[1024];
+        ssize_t n = recv(scrape->fd, request, sizeof(request), 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        char *body = NULL;
+        size_t length = 0;
+        FILE *out = n > 0 ? open_memstream(&body, &length) : NULL;
+        if (out == NULL) {
+            closeMetricsConnection(scrape);
+            return;
+        }
+        fprintf(out, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n");
+        writeMetrics(out);
+        fclose(out);
+        scrape->response = body;
+        scrape->responseLength = length;
+    }
+    if (scrape->response != NULL) {
+        ssize_t n = send(scrape->fd, scrape->response + scrape->sent, scrape->responseLength - scrape->sent,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            closeMetricsConnection(scrape);
+            return;
+        }
+        scrape->sent += n > 0 ? (size_t)n : 0;
+        if (scrape->sent == scrape->responseLength) {
+            closeMetricsConnection(scrape); // HTTP/1.0: closing ends the page
+        }
+    }
+}
+
+/**
+ * @brief Serves lookups and edits on a local socket until stopSpeedDialServer() is called.
+ * Single-threaded: the event loop is the manager's only writer, and it pushes
+ * invalidations to subscribers as soon as each batch of requests has been applied.
+ *
+ * @param socketPath The filesystem path of the socket to listen on (replaced if present).
+ * @return EXIT_SUCCESS after a clean stop; EXIT_FAILURE if the socket could not be set up.
+ */
+int runSpeedDialServer(const char *socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        printf("Error: Socket path '%s' is too long.\n", socketPath);
+        return EXIT_FAILURE;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("Failed to create server socket");
+        return EXIT_FAILURE;
+    }
+    unlink(socketPath);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 16) != 0) {
+        perror("Failed to listen on server socket");
+        close(listener);
+        return EXIT_FAILURE;
+    }
+
+    ServerConnection connections[MAX_SERVER_CLIENTS];
+    for (int c = 0; c < MAX_SERVER_CLIENTS; c++) {
+        connections[c].fd = -1;
+    }
+    MetricsConnection scrapes[MAX_METRICS_CONNECTIONS];
+    for (int s = 0; s < MAX_METRICS_CONNECTIONS; s++) {
+        scrapes[s] = (MetricsConnection){-1, NULL, 0, 0, 0};
+    }
+    ChangeCursor cursor = subscribeChanges(false);
+    serverStopping = false;
+    bool backlog = false; // Requests were left queued by the last pass
+    int rotation = 0;
+    printf("Speed dial server listening on '%s'.\n", socketPath);
+
+    while (!serverStopping) {
+        // Slots: the listener, the connections, the metrics listener, then the metrics scrapes
+        struct pollfd fds[MAX_SERVER_CLIENTS + 2 + MAX_METRICS_CONNECTIONS];
+        struct pollfd *scrapeFds = &fds[MAX_SERVER_CLIENTS + 2];
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        fds[MAX_SERVER_CLIENTS + 1].fd = metricsListener;
+        fds[MAX_SERVER_CLIENTS + 1].events = POLLIN;
+        for (int c = 0; c < MAX_SERVER_CLIENTS; c++) {
+            fds[c + 1].fd = connections[c].fd; // Negative descriptors are ignored by poll()
+            fds[c + 1].events = (connections[c].inboxLength < SERVER_LINE_LENGTH ? POLLIN : 0) |
+                                (connections[c].outboxLength > 0 ? POLLOUT : 0);
+        }
+        for (int s = 0; s < MAX_METRICS_CONNECTIONS; s++) {
+            scrapeFds[s].fd = scrapes[s].fd;
+            scrapeFds[s].events = scrapes[s].response == NULL ? POLLIN : POLLOUT;
+        }
+        if (poll(fds, MAX_SERVER_CLIENTS + 2 + MAX_METRICS_CONNECTIONS, backlog ? 0 : 100) < 0) {
+            continue; // Interrupted; re-check serverStopping
+        }
+        uint64_t now = nowNanoseconds();
+        for (int s = 0; s < MAX_METRICS_CONNECTIONS; s++) {
+            if (scrapes[s].fd >= 0 && scrapeFds[s].revents != 0) {
+                serveMetricsConnection(&scrapes[s], scrapeFds[s].revents);
+            }
+            if (scrapes[s].fd >= 0 && now > scrapes[s].deadline) {
+                closeMetricsConnection(&scrapes[s]);
+            }
+        }
+        if (fds[MAX_SERVER_CLIENTS + 1].revents & POLLIN) {
+            acceptMetricsConnection(scrapes);
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, NULL, NULL);
+            int c = 0;
+            while (c < MAX_SERVER_CLIENTS && connections[c].fd >= 0) {
+                c++;
+            }
+            if (fd >= 0 && c == MAX_SERVER_CLIENTS) {
+                close(fd); // Server full
+            } else if (fd >= 0) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                connections[c].fd = fd;
+                connections[c].subscribed = false;
+                connections[c].flushOwed = false;
+                connections[c].listDirectory = -1;
+                connections[c].inboxLength = 0;
+                connections[c].outboxLength = 0;
+            }
+        }
+
+        for (int c = 0; c < MAX_SERVER_CLIENTS; c++) {
+            ServerConnection *connection = &connections[c];
+            if (connection->fd >= 0 && (fds[c + 1].revents & POLLOUT)) {
+                flushOutbox(connection);
+            }
+            if (connection->fd < 0 || !(fds[c + 1].revents & (POLLIN | POLLHUP | POLLERR)) ||
+                connection->inboxLength == SERVER_LINE_LENGTH) {
+                continue; // Nothing to read, or room only after queued requests run
+            }
+            ssize_t n = recv(connection->fd, connection->inbox + connection->inboxLength,
+                             SERVER_LINE_LENGTH - connection->inboxLength, 0);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                continue;
+            }
+            if (n <= 0) {
+                close(connection->fd);
+                connection->fd = -1;
+                continue;
+            }
+            connection->inboxLength += (size_t)n;
+            if (connection->inboxLength == SERVER_LINE_LENGTH &&
+                memchr(connection->inbox, '\n', SERVER_LINE_LENGTH) == NULL) {
+                close(connection->fd); // A line longer than the protocol allows
+                connection->fd = -1;
+            }
+        }
+
+        serverLoad = runServerRequests(connections, rotation);
+        rotation = (rotation + 1) % MAX_SERVER_CLIENTS;
+        backlog = false;
+        for (int c = 0; c < MAX_SERVER_CLIENTS; c++) {
+            backlog |= nextRequestLane(&connections[c]) >= 0;
+        }
+        pushInvalidations(connections, &cursor);
+    }
+
+    for (int c = 0; c < MAX_SERVER_CLIENTS; c++) {
+        if (connections[c].fd >= 0) {
+            close(connections[c].fd);
+        }
+    }
+    for (int s = 0; s < MAX_METRICS_CONNECTIONS; s++) {
+        if (scrapes[s].fd >= 0) {
+            closeMetricsConnection(&scrapes[s]);
+        }
+    }
+    close(listener);
+    unlink(socketPath);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Asks a running server loop to return (safe to call from another thread or a signal handler).
+ */
+void stopSpeedDialServer() {
+    serverStopping = true;
+}
+
+// --- Metrics ---
+
+static _Thread_local MetricsShard *threadMetricsShard;
+// Upper bounds of the latency buckets in nanoseconds; the last bucket has none
+static const uint64_t latencyBucketBounds[LATENCY_BUCKETS - 1] = {250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 1000000};
+static const char *metricOperationNames[METRIC_OPERATION_COUNT] = {"add", "get", "remove", "dial", "update", "upsert", "cas"};
+
+/**
+ * @brief Turns collection of operation counts and latencies on or off (off initially).
+ * While off, operations pay one relaxed load; while on, two clock reads and three
+ * uncontended atomic adds on the calling thread's own shard. Neither allocates.
+ */
+void enableMetrics(bool enabled) {
+    atomic_store(&metricsEnabled, enabled);
+}
+
+static uint64_t metricsStart() {
+    return atomic_load_explicit(&metricsEnabled, memory_order_relaxed) ? nowNanoseconds() : 0;
+}
+
+static void recordMetric(MetricOperation operation, uint64_t start, bool succeeded) {
+    if (start == 0) {
+        return;
+    }
+    uint64_t elapsed = nowNanoseconds() - start;
+    MetricsShard *shard = threadMetricsShard;
+    if (shard == NULL) {
+        int index = atomic_fetch_add(&metricsShardCount, 1);
+        shard = &metricsShards[index < MAX_METRICS_THREADS ? index : MAX_METRICS_THREADS - 1];
+        threadMetricsShard = shard;
+    }
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && elapsed > latencyBucketBounds[bucket]) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(succeeded ? &shard->succeeded[operation] : &shard->failed[operation], 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->latencyBuckets[operation][bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->latencySum[operation], elapsed, memory_order_relaxed);
+}
+
+/**
+ * @brief Writes every metric in the Prometheus text exposition format (version 0.0.4).
+ * Per-thread shards are summed while they keep changing, so no operation ever waits
+ * for an export; a scrape may see a count a moment ahead of its histogram.
+ *
+ * @param out The stream to write to.
+ */
+void writeMetrics(FILE *out) {
+    uint64_t succeeded[METRIC_OPERATION_COUNT] = {0};
+    uint64_t failed[METRIC_OPERATION_COUNT] = {0};
+    uint64_t buckets[METRIC_OPERATION_COUNT][LATENCY_BUCKETS] = {{0}};
+    uint64_t sums[METRIC_OPERATION_COUNT] = {0};
+    int shards = atomic_load(&metricsShardCount);
+    for (int s = 0; s < shards && s < MAX_METRICS_THREADS; s++) {
+        const MetricsShard *shard = &metricsShards[s];
+        for (int op = 0; op < METRIC_OPERATION_COUNT; op++) {
+            succeeded[op] += atomic_load_explicit(&shard->succeeded[op], memory_order_relaxed);
+            failed[op] += atomic_load_explicit(&shard->failed[op], memory_order_relaxed);
+            sums[op] += atomic_load_explicit(&shard->latencySum[op], memory_order_relaxed);
+            for (int b = 0; b < LATENCY_BUCKETS; b++) {
+                buckets[op][b] += atomic_load_explicit(&shard->latencyBuckets[op][b], memory_order_relaxed);
+            }
+        }
+    }
+
+    fprintf(out, "# HELP speeddial_operations_total Manager operations by outcome.\n");
+    fprintf(out, "# TYPE speeddial_operations_total counter\n");
+    for (int op = 0; op < METRIC_OPERATION_COUNT; op++) {
+        fprintf(out, "speeddial_operations_total{operation=\"%s\",outcome=\"success\"} %llu\n",
+                metricOperationNames[op], (unsigned long long)succeeded[op]);
+        fprintf(out, "speeddial_operations_total{operation=\"%s\",outcome=\"failure\"} %llu\n",
+                metricOperationNames[op], (unsigned long long)failed[op]);
+    }
+    fprintf(out, "# HELP speeddial_operation_duration_seconds Manager operation latency.\n");
+    fprintf(out, "# TYPE speeddial_operation_duration_seconds histogram\n");
+    for (int op = 0; op < METRIC_OPERATION_COUNT; op++) {
+        uint64_t cumulative = 0;
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            cumulative += buckets[op][b];
+            if (b < LATENCY_BUCKETS - 1) {
+                fprintf(out, "speeddial_operation_duration_seconds_bucket{operation=\"%s\",le=\"%g\"} %llu\n",
+                        metricOperationNames[op], (double)latencyBucketBounds[b] / 1e9, (unsigned long long)cumulative);
+            } else {
+                fprintf(out, "speeddial_operation_duration_seconds_bucket{operation=\"%s\",le=\"+Inf\"} %llu\n",
+                        metricOperationNames[op], (unsigned long long)cumulative);
+            }
+        }
+        fprintf(out, "speeddial_operation_duration_seconds_sum{operation=\"%s\"} %.9f\n", metricOperationNames[op],
+                (double)sums[op] / 1e9);
+        fprintf(out, "speeddial_operation_duration_seconds_count{operation=\"%s\"} %llu\n", metricOperationNames[op],
+                (unsigned long long)cumulative);
+    }
+
+    fprintf(out, "# HELP speeddial_entries Entries per directory.\n");
+    fprintf(out, "# TYPE speeddial_entries gauge\n");
+    for (int d = 0; d < MAX_DIRECTORIES && manager.initialized; d++) {
+        fprintf(out, "speeddial_entries{directory=\"%s\"} %d\n", manager.directories[d].name,
+                manager.directories[d].currentCount);
+    }
+    const char *kinds[] = {"entries", "strings", "indexes", "caches", "slack"};
+    fprintf(out, "# HELP speeddial_directory_memory_bytes Memory each directory costs, by kind.\n");
+    fprintf(out, "# TYPE speeddial_directory_memory_bytes gauge\n");
+    for (int d = 0; d < MAX_DIRECTORIES && manager.initialized; d++) {
+        DirectoryMemory memory;
+        getDirectoryMemory(manager.directories[d].name, &memory);
+        size_t bytes[] = {memory.entries, memory.strings, memory.indexes, memory.caches, memory.slack};
+        for (int k = 0; k < 5; k++) {
+            fprintf(out, "speeddial_directory_memory_bytes{directory=\"%s\",kind=\"%s\"} %zu\n",
+                    manager.directories[d].name, kinds[k], bytes[k]);
+        }
+    }
+    MemoryComponent parts[12];
+    int count = getFootprint(parts);
+    fprintf(out, "# HELP speeddial_memory_bytes Memory reserved by each component.\n");
+    fprintf(out, "# TYPE speeddial_memory_bytes gauge\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "speeddial_memory_bytes{component=\"%s\"} %zu\n", parts[i].component, parts[i].bytes);
+    }
+
+    fprintf(out, "# HELP speeddial_lookup_cache_hits_total Lookups answered by the lookup cache.\n");
+    fprintf(out, "# TYPE speeddial_lookup_cache_hits_total counter\n");
+    fprintf(out, "speeddial_lookup_cache_hits_total %llu\n", (unsigned long long)atomic_load(&manager.lookupCacheHits));
+    fprintf(out, "# HELP speeddial_lookup_cache_misses_total Lookups of existing codes that scanned the directory.\n");
+    fprintf(out, "# TYPE speeddial_lookup_cache_misses_total counter\n");
+    fprintf(out, "speeddial_lookup_cache_misses_total %llu\n",
+            (unsigned long long)atomic_load(&manager.lookupCacheMisses));
+    fprintf(out, "# HELP speeddial_calls_logged_total Calls recorded in the call log.\n");
+    fprintf(out, "# TYPE speeddial_calls_logged_total counter\n");
+    fprintf(out, "speeddial_calls_logged_total %llu\n",
+            (unsigned long long)(callLog.header != NULL ? atomic_load(&callLog.header->head) : 0));
+    fprintf(out, "# HELP speeddial_changes_total Changes published on the change feed.\n");
+    fprintf(out, "# TYPE speeddial_changes_total counter\n");
+    fprintf(out, "speeddial_changes_total %llu\n", (unsigned long long)atomic_load(&changeFeed.head));
+    const char *classNames[REQUEST_CLASS_COUNT] = {"emergency", "dial", "edit", "bulk"};
+    fprintf(out, "# HELP speeddial_rejected_requests_total Server requests refused by rate limits or load shedding.\n");
+    fprintf(out, "# TYPE speeddial_rejected_requests_total counter\n");
+    for (int c = 0; c < REQUEST_CLASS_COUNT; c++) {
+        fprintf(out, "speeddial_rejected_requests_total{class=\"%s\"} %llu\n", classNames[c],
+                (unsigned long long)atomic_load(&rejectedRequests[c]));
+    }
+}
+
+/**
+ * @brief Writes the metrics to a file for a textfile collector, replacing it atomically.
+ *
+ * @param path The file to write (a temporary file beside it is renamed over it).
+ * @return true if the file was written; false otherwise.
+ */
+bool writeMetricsFile(const char *path) {
+    char temporary[512];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE *out = fopen(temporary, "w");
+    if (out == NULL) {
+        perror("Failed to write metrics file");
+        return false;
+    }
+    writeMetrics(out);
+    if (fclose(out) != 0 || rename(temporary, path) != 0) {
+        perror("Failed to write metrics file");
+        unlink(temporary);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Makes runSpeedDialServer() also answer HTTP scrapes of its metrics on
+ * 127.0.0.1:port, and turns metrics collection on.
+ *
+ * @param port The TCP port to listen on.
+ * @return true if listening; false if the port could not be bound.
+ */
+bool listenForMetrics(int port) {
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 8) != 0) {
+        perror("Failed to listen for metrics scrapes");
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    if (metricsListener >= 0) {
+        close(metricsListener);
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); // accept() must not wait if a scraper gave up
+    metricsListener = fd;
+    enableMetrics(true);
+    return true;
+}
+
+// --- Rate Limiting ---
+
+/**
+ * @brief Limits a tenant's requests of one class.
+ * The whole rate is open to any core, so one busy thread gets all of it. Cores lease
+ * up to burst / (4 * RATE_LIMIT_SHARDS) tokens at a time; tokens a core leased but
+ * has not used can exceed the burst by at most that much per shard.
+ *
+ * @param directoryName The tenant's directory.
+ * @param requestClass The class of requests to limit.
+ * @param perSecond The sustained rate allowed, or 0 to remove the limit.
+ * @param burst The number of requests allowed back to back.
+ * @return true if the limit was set; false if the directory does not exist or the values are invalid.
+ */
+bool setRateLimit(const char *directoryName, RequestClass requestClass, double perSecond, double burst) {
+    int dirIndex = findDirectoryIndex(directoryName);
+    if (dirIndex == -1 || requestClass == REQUEST_EMERGENCY || requestClass >= REQUEST_CLASS_COUNT || perSecond < 0 ||
+        burst < 1) {
+        MANAGER_LOG("Error: Invalid rate limit for directory '%s'.\n", directoryName);
+        return false;
+    }
+    RateLimiter *limiter = &rateLimits[dirIndex][requestClass];
+    double lease = burst / (4 * RATE_LIMIT_SHARDS);
+    limiter->interval = perSecond > 0 ? (uint64_t)(1e9 / perSecond) : 0;
+    limiter->tolerance = (uint64_t)((burst - 1) * (double)limiter->interval);
+    limiter->lease = lease < 1 ? 1 : (uint32_t)lease;
+    atomic_store(&limiter->theoreticalArrival, 0);
+    for (int s = 0; s < RATE_LIMIT_SHARDS; s++) {
+        atomic_store(&limiter->shards[s].tokens, 0);
+    }
+    return true;
+}
+
+/**
+ * @brief Takes a token from the calling core's shard, leasing more from the tenant's
+ * bucket when the shard is empty (a whole lease if the bucket allows, else one token).
+ * Lock-free and allocation-free: usually one CAS on the shard.
+ *
+ * @param dirIndex The tenant's directory index.
+ * @param requestClass The class of the request.
+ * @return true if the request may proceed; false if the tenant is over its limit.
+ */
+bool admitRequest(int dirIndex, RequestClass requestClass) {
+    RateLimiter *limiter = &rateLimits[dirIndex][requestClass];
+    if (limiter->interval == 0) {
+        return true;
+    }
+    int cpu = sched_getcpu();
+    RateLimitShard *shard = &limiter->shards[(cpu < 0 ? 0 : cpu) % RATE_LIMIT_SHARDS];
+    uint32_t tokens = atomic_load_explicit(&shard->tokens, memory_order_relaxed);
+    while (tokens > 0) {
+        if (atomic_compare_exchange_weak_explicit(&shard->tokens, &tokens, tokens - 1, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            return true;
+        }
+    }
+
+    uint64_t now = nowNanoseconds();
+    uint64_t arrival = atomic_load_explicit(&limiter->theoreticalArrival, memory_order_relaxed);
+    for (;;) {
+        uint64_t start = arrival > now ? arrival : now;
+        if (start - now > limiter->tolerance) {
+            atomic_fetch_add_explicit(&rejectedRequests[requestClass], 1, memory_order_relaxed);
+            return false;
+        }
+        // A lease of n tokens fits if its last token would still be within the burst
+        uint64_t leased = (uint64_t)limiter->lease;
+        if (start - now + (leased - 1) * limiter->interval > limiter->tolerance) {
+            leased = 1;
+        }
+        if (atomic_compare_exchange_weak_explicit(&limiter->theoreticalArrival, &arrival,
+                                                  start + leased * limiter->interval, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            atomic_fetch_add_explicit(&shard->tokens, (uint32_t)leased - 1, memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+// --- Client Library ---
+
+static inline uint32_t clientCacheSlot(const char *directoryName, const char *speedDialCode) {
+    return (hashString(directoryName) * 31u ^ hashString(speedDialCode)) & (CLIENT_CACHE_SIZE - 1);
+}
+
+/**
+ * @brief Takes the next complete line from the client's inbox, receiving more if needed.
+ * @param wait true to block until a line arrives; false to return only already-sent data.
+ * @return true if line holds a line; false if none is available or the connection closed.
+ */
+static bool clientReadLine(SpeedDialClient *client, char *line, size_t size, bool wait) {
+    for (;;) {
+        char *newline = memchr(client->inbox, '\n', client->inboxLength);
+        if (newline != NULL) {
+            size_t length = (size_t)(newline - client->inbox);
+            size_t copied = length < size - 1 ? length : size - 1;
+            memcpy(line, client->inbox, copied);
+            line[copied] = '\0';
+            client->inboxLength -= length + 1;
+            memmove(client->inbox, newline + 1, client->inboxLength);
+            return true;
+        }
+        if (client->inboxLength == sizeof(client->inbox)) {
+            client->inboxLength = 0; // Not our protocol; drop it
+        }
+        ssize_t n = recv(client->fd, client->inbox + client->inboxLength, sizeof(client->inbox) - client->inboxLength,
+                         wait ? 0 : MSG_DONTWAIT);
+        if (n <= 0) {
+            return false;
+        }
+        client->inboxLength += (size_t)n;
+    }
+}
+
+/**
+ * @brief Applies a pushed INV or FLUSH line to the client cache.
+ * @return true if the line was a push; false if it is a response to a request.
+ */
+static bool clientApplyPush(SpeedDialClient *client, char *line) {
+    if (strcmp(line, "FLUSH") == 0) {
+        for (int i = 0; i < CLIENT_CACHE_SIZE; i++) {
+            client->cache[i].valid = false;
+        }
+        client->invalidations++;
+        return true;
+    }
+    char *fields[3];
+    if (strncmp(line, "INV\t", 4) != 0 || splitFields(line, fields, 3) != 3) {
+        return false;
+    }
+    ClientCacheEntry *entry = &client->cache[clientCacheSlot(fields[1], fields[2])];
+    if (entry->valid && strcmp(entry->directoryName, fields[1]) == 0 && strcmp(entry->speedDialCode, fields[2]) == 0) {
+        entry->valid = false;
+        client->invalidations++;
+    }
+    return true;
+}
+
+/**
+ * @brief Connects to a lookup server and subscribes to its invalidations.
+ *
+ * @param client The client to initialize.
+ * @param socketPath The server's socket path.
+ * @return true if connected; false otherwise.
+ */
+bool connectSpeedDialClient(SpeedDialClient *client, const char *socketPath) {
+    memset(client, 0, sizeof(*client));
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+    client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client->fd < 0 || connect(client->fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        perror("Failed to connect to speed dial server");
+        if (client->fd >= 0) {
+            close(client->fd);
+        }
+        client->fd = -1;
+        return false;
+    }
+    sendLine(client->fd, "SUB");
+    char line[SERVER_LINE_LENGTH];
+    if (!clientReadLine(client, line, sizeof(line), true) || strcmp(line, "OK") != 0) {
+        printf("Error: Speed dial server refused the subscription.\n");
+        disconnectSpeedDialClient(client);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Looks up a phone number, answering from the local cache when possible.
+ * Invalidations already pushed by the server are applied first, so a cached answer
+ * never predates an edit the server has reported.
+ *
+ * @param client A connected client.
+ * @param directoryName The name of the directory to search within.
+ * @param speedDialCode The speed dial code.
+ * @return The phone number (valid until the next call on this client), or NULL if
+ * the code is not found or the server is unreachable.
+ */
+const char *clientGetPhoneNumber(SpeedDialClient *client, const char *directoryName, const char *speedDialCode) {
+    char line[SERVER_LINE_LENGTH];
+    while (clientReadLine(client, line, sizeof(line), false)) {
+        clientApplyPush(client, line);
+    }
+
+    ClientCacheEntry *entry = &client->cache[clientCacheSlot(directoryName, speedDialCode)];
+    if (entry->valid && strcmp(entry->directoryName, directoryName) == 0 &&
+        strcmp(entry->speedDialCode, speedDialCode) == 0) {
+        client->hits++;
+        return entry->phoneNumber;
+    }
+
+    client->misses++;
+    sendLine(client->fd, "GET\t%s\t%s", directoryName, speedDialCode);
+    while (clientReadLine(client, line, sizeof(line), true)) {
+        if (clientApplyPush(client, line)) {
+            continue;
+        }
+        if (strncmp(line, "OK\t", 3) != 0) {
+            return NULL; // NOTFOUND or an error
+        }
+        strncpy(entry->directoryName, directoryName, MAX_DIR_NAME_LENGTH - 1);
+        entry->directoryName[MAX_DIR_NAME_LENGTH - 1] = '\0';
+        strncpy(entry->speedDialCode, speedDialCode, MAX_CODE_LENGTH - 1);
+        entry->speedDialCode[MAX_CODE_LENGTH - 1] = '\0';
+        size_t numberLength = strnlen(line + 3, MAX_PHONE_LENGTH - 1);
+        memcpy(entry->phoneNumber, line + 3, numberLength);
+        entry->phoneNumber[numberLength] = '\0';
+        entry->valid = true;
+        return entry->phoneNumber;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Closes the connection to the server.
+ */
+void disconnectSpeedDialClient(SpeedDialClient *client) {
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+}
+
+// --- Trace Capture and Replay ---
+
+// The calling thread's buffer is traceRecorder.buffers[threadTraceSlot] while threadTraceGeneration is current.
+// Threads keep no pointer to it, as stopTrace() frees every buffer while other threads sit idle.
+static _Thread_local int threadTraceSlot;
+static _Thread_local uint32_t threadTraceGeneration;
+
+static uint32_t traceKey(const char *text) {
+    uint32_t hash = 2166136261u ^ traceRecorder.salt; // Salted FNV-1a
+    for (const unsigned char *p = (const unsigned char *)text; *p != '\0'; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Writes a thread's collected records to their reserved place in the trace file.
+ */
+static void flushTraceBuffer(TraceBuffer *buffer) {
+    if (buffer->count == 0) {
+        return;
+    }
+    uint64_t first = atomic_fetch_add(&traceRecorder.fileRecords, (uint64_t)buffer->count);
+    off_t offset = (off_t)(sizeof(TraceHeader) + first * sizeof(TraceRecord));
+    if (pwrite(traceRecorder.fd, buffer->records, (size_t)buffer->count * sizeof(TraceRecord), offset) < 0) {
+        perror("Failed to write trace");
+    }
+    buffer->count = 0;
+}
+
+static void traceOperation(TraceOperation operation, const char *directoryName, const char *speedDialCode,
+                           const char *phoneNumber) {
+    TraceBuffer *buffer;
+    if (threadTraceGeneration != traceRecorder.generation) {
+        int index = atomic_fetch_add(&traceRecorder.bufferCount, 1);
+        buffer = index < MAX_TRACE_THREADS ? (TraceBuffer *)calloc(1, sizeof(TraceBuffer)) : NULL;
+        threadTraceGeneration = traceRecorder.generation;
+        threadTraceSlot = buffer != NULL ? index : -1;
+        if (buffer != NULL) {
+            traceRecorder.buffers[index] = buffer;
+        }
+    }
+    if (threadTraceSlot < 0) {
+        return; // Too many threads: this one goes untraced until the next trace
+    }
+    buffer = traceRecorder.buffers[threadTraceSlot];
+
+    TraceRecord *record = &buffer->records[buffer->count];
+    int dirIndex = findDirectoryIndex(directoryName);
+    record->timestamp = nowNanoseconds() - traceRecorder.startNanoseconds;
+    record->codeKey = traceKey(speedDialCode);
+    record->numberKey = phoneNumber != NULL ? traceKey(phoneNumber) : 0;
+    record->operation = (uint8_t)operation;
+    record->directoryIndex = dirIndex == -1 ? TRACE_NO_DIRECTORY : (uint8_t)dirIndex;
+    memset(record->reserved, 0, sizeof(record->reserved));
+    if (++buffer->count == TRACE_BUFFER_RECORDS) {
+        flushTraceBuffer(buffer);
     }
+}
 
-    Directory *dir = &manager.directories[dirIndex];
+/**
+ * @brief Starts recording every addNumber(), getPhoneNumber(), removeNumber() and
+ * dialSpeedDial() call to a compact binary trace. The current entries are recorded
+ * first, as adds, so a replay starts from the same state.
+ *
+ * @param path The trace file to create (replaced if present).
+ * @return true if recording started; false if the file could not be created.
+ */
+bool startTrace(const char *path) {
+    if (atomic_load(&traceRecorder.active)) {
+        stopTrace();
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Failed to create trace file");
+        return false;
+    }
+    TraceHeader header = {TRACE_MAGIC, sizeof(TraceRecord), (int64_t)time(NULL)};
+    if (pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+        perror("Failed to write trace header");
+        close(fd);
+        return false;
+    }
 
-    printf("\n--- Listing numbers in '%s' (%d/%d) ---\n",
-           directoryName, dir->currentCount, MAX_NUMBERS_PER_DIRECTORY);
-    if (dir->currentCount == 0) {
-        printf("  Directory is empty.\n");
-    } else {
+    traceRecorder.fd = fd;
+    traceRecorder.salt = (uint32_t)nowNanoseconds() ^ ((uint32_t)getpid() << 16); // Never written out
+    traceRecorder.generation++;
+    atomic_store(&traceRecorder.fileRecords, 0);
+    atomic_store(&traceRecorder.bufferCount, 0);
+    traceRecorder.startNanoseconds = nowNanoseconds();
+    atomic_store(&traceRecorder.active, true);
+    for (int d = 0; d < MAX_DIRECTORIES && manager.initialized; d++) {
+        const Directory *dir = &manager.directories[d];
         for (int i = 0; i < dir->currentCount; i++) {
-            printf("  %s: %s\n", dir->entries[i].speedDialCode, dir->entries[i].phoneNumber);
+            traceOperation(TRACE_ADD, dir->name, dir->entries[i].speedDialCode, dir->entries[i].phoneNumber);
         }
     }
+    return true;
 }
 
 /**
- * @brief Lists the names of all directories currently managed by the speed dial manager.
+ * @brief Stops recording and writes out every thread's remaining records.
+ * Traced operations must not be running on other threads while this is called.
  */
-void listAllDirectoryNames() {
-    if (!manager.initialized) {
-        printf("Error: SpeedDialManager not initialized. Call initializeSpeedDialManager() first.\n");
+void stopTrace() {
+    if (!atomic_exchange(&traceRecorder.active, false)) {
         return;
     }
+    int count = atomic_load(&traceRecorder.bufferCount);
+    for (int i = 0; i < count && i < MAX_TRACE_THREADS; i++) {
+        if (traceRecorder.buffers[i] == NULL) {
+            continue; // Its thread could not get one
+        }
+        flushTraceBuffer(traceRecorder.buffers[i]);
+        free(traceRecorder.buffers[i]);
+        traceRecorder.buffers[i] = NULL;
+    }
+    close(traceRecorder.fd);
+    traceRecorder.fd = -1;
+}
 
-    printf("\n--- All available directories ---\n");
-    for (int i = 0; i < MAX_DIRECTORIES; i++) {
-        printf("  %s\n", manager.directories[i].name);
+static int compareTraceRecords(const void *a, const void *b) {
+    uint64_t x = ((const TraceRecord *)a)->timestamp;
+    uint64_t y = ((const TraceRecord *)b)->timestamp;
+    return (x > y) - (x < y);
+}
+
+static int compareLatencies(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Replays a trace against a freshly initialized manager and reports throughput
+ * and per-operation latency. Hashed keys become synthetic codes and numbers, so the
+ * replay has the original's shape (directories, repeats, misses, timing) but none of its data.
+ *
+ * @param path The trace file.
+ * @param speed 1 for the original timing, 10 for ten times faster, 0 for as fast as possible.
+ * @return EXIT_SUCCESS if the trace was replayed; EXIT_FAILURE if it could not be read.
+ */
+int replayTrace(const char *path, double speed) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    TraceHeader header;
+    if (fd < 0 || fstat(fd, &st) != 0 || pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        header.magic != TRACE_MAGIC || header.recordSize != sizeof(TraceRecord)) {
+        printf("Error: '%s' is not a speed dial trace.\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return EXIT_FAILURE;
+    }
+    size_t count = ((size_t)st.st_size - sizeof(header)) / sizeof(TraceRecord);
+    TraceRecord *records = (TraceRecord *)malloc(count * sizeof(TraceRecord) + 1);
+    uint32_t *latencies = (uint32_t *)malloc(count * sizeof(uint32_t) * 2 + 1);
+    if (records == NULL || latencies == NULL ||
+        pread(fd, records, count * sizeof(TraceRecord), sizeof(header)) != (ssize_t)(count * sizeof(TraceRecord))) {
+        perror("Failed to read trace");
+        free(records);
+        free(latencies);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    qsort(records, count, sizeof(TraceRecord), compareTraceRecords);
+
+    bool wasQuiet = manager.quiet;
+    manager.quiet = true;
+    if (manager.initialized) {
+        freeSpeedDialManager();
+    }
+    initializeSpeedDialManager();
+
+    uint64_t start = nowNanoseconds();
+    size_t counts[TRACE_OPERATION_COUNT] = {0};
+    for (size_t i = 0; i < count; i++) {
+        const TraceRecord *record = &records[i];
+        if (speed > 0) {
+            uint64_t due = start + (uint64_t)((double)record->timestamp / speed);
+            for (uint64_t now = nowNanoseconds(); now < due; now = nowNanoseconds()) {
+                struct timespec pause = {0, (long)(due - now < 1000000 ? due - now : 1000000)};
+                nanosleep(&pause, NULL);
+            }
+        }
+        char code[MAX_CODE_LENGTH];
+        char number[MAX_PHONE_LENGTH];
+        snprintf(code, MAX_CODE_LENGTH, "c%08x", record->codeKey);
+        snprintf(number, MAX_PHONE_LENGTH, "%010u", record->numberKey);
+        const char *directoryName = record->directoryIndex < MAX_DIRECTORIES
+                                        ? manager.directories[record->directoryIndex].name : "(unknown)";
+
+        uint64_t begin = nowNanoseconds();
+        switch (record->operation) {
+        case TRACE_ADD: addNumber(directoryName, code, number); break;
+        case TRACE_GET: getPhoneNumber(directoryName, code); break;
+        case TRACE_REMOVE: removeNumber(directoryName, code); break;
+        case TRACE_DIAL: dialSpeedDial(directoryName, code); break;
+        case TRACE_UPDATE: updateNumber(directoryName, code, number); break;
+        case TRACE_UPSERT: upsertNumber(directoryName, code, number); break;
+        default: continue;
+        }
+        uint64_t elapsed = nowNanoseconds() - begin;
+        latencies[i] = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+        counts[record->operation]++;
+    }
+    double seconds = (double)(nowNanoseconds() - start) / 1e9;
+
+    printf("replay: %zu operations in %.3f s (%.0f ops/s)", count, seconds, (double)count / seconds);
+    if (speed > 0) {
+        printf(", paced at %gx the recorded speed", speed);
     }
+    printf("\n");
+    const char *names[TRACE_OPERATION_COUNT] = {NULL, "add", "get", "remove", "dial", "update", "upsert"};
+    for (int operation = TRACE_ADD; operation < TRACE_OPERATION_COUNT; operation++) {
+        if (counts[operation] == 0) {
+            continue;
+        }
+        uint32_t *sorted = latencies + count; // Second half of the allocation
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (records[i].operation == operation) {
+                sorted[n++] = latencies[i];
+            }
+        }
+        qsort(sorted, n, sizeof(uint32_t), compareLatencies);
+        printf("  %-7s %9zu  p50 %6u ns  p99 %7u ns  max %8u ns\n", names[operation], n, sorted[n / 2],
+               sorted[n * 99 / 100], sorted[n - 1]);
+    }
+
+    free(records);
+    free(latencies);
+    freeSpeedDialManager();
+    manager.quiet = wasQuiet;
+    return EXIT_SUCCESS;
+}
+
+// --- Benchmarks ---
+
+static uint64_t nextRandom(uint64_t *state) {
+    // xorshift64*: fast and good enough for synthetic workloads
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
 }
 
 /**
- * @brief Frees all dynamically allocated memory used by the SpeedDialManager.
- * This should be called before the program exits to prevent memory leaks.
+ * @brief Measures portability lookups against a synthetic mapped database.
+ * Reports latency per lookup and memory per entry.
  */
-void freeSpeedDialManager() {
-    if (!manager.initialized) {
-        printf("SpeedDialManager not initialized or already freed.\n");
-        return;
+static int benchmarkPortability(size_t entries) {
+    const char *path = "/tmp/speeddial_portability.bin";
+    const size_t lookups = 1000000;
+
+    uint64_t *records = (uint64_t *)malloc(entries * sizeof(uint64_t));
+    uint64_t *queries = (uint64_t *)malloc(lookups * sizeof(uint64_t));
+    if (records == NULL || queries == NULL) {
+        perror("Failed to allocate benchmark data");
+        free(records);
+        free(queries);
+        return EXIT_FAILURE;
+    }
+    uint64_t seed = 88172645463325252ull;
+    uint64_t number = 2000000000ull; // Ten-digit numbers with random gaps
+    for (size_t i = 0; i < entries; i++) {
+        number += 1 + nextRandom(&seed) % 64;
+        records[i] = (number << PORTABILITY_CARRIER_BITS) | (nextRandom(&seed) % 500);
+    }
+    for (size_t i = 0; i < lookups; i++) {
+        queries[i] = records[nextRandom(&seed) % entries] >> PORTABILITY_CARRIER_BITS;
+        if (i % 4 == 0) {
+            queries[i] += 1; // About a quarter of lookups miss (or hit a neighbour)
+        }
+    }
+    bool written = writePortabilityDb(path, records, entries);
+    free(records);
+    if (!written || !openPortabilityDb(path)) {
+        free(queries);
+        return EXIT_FAILURE;
     }
 
-    printf("Freeing SpeedDialManager memory...\n");
-    for (int i = 0; i < MAX_DIRECTORIES; i++) {
-        if (manager.directories[i].entries != NULL) {
-            free(manager.directories[i].entries);
-            manager.directories[i].entries = NULL; // Prevent double free
+    uint64_t found = 0;
+    uint64_t start = nowNanoseconds();
+    for (size_t i = 0; i < lookups; i++) {
+        found += findPortabilityRecord(portabilityDb.records, portabilityDb.count, queries[i]) >= 0;
+    }
+    uint64_t elapsed = nowNanoseconds() - start;
+
+    printf("portability: %zu entries, %zu lookups (%llu found)\n", entries, lookups, (unsigned long long)found);
+    printf("  lookup latency : %.1f ns\n", (double)elapsed / (double)lookups);
+    printf("  memory/entry   : %.1f bytes\n", (double)portabilityDb.mappedBytes / (double)portabilityDb.count);
+
+    closePortabilityDb();
+    unlink(path);
+    free(queries);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Measures bulk caller-ID enrichment of a CDR batch against a full manager.
+ */
+static int benchmarkEnrichment(size_t batchSize) {
+    manager.quiet = true;
+    initializeSpeedDialManager();
+    for (int d = 0; d < MAX_DIRECTORIES; d++) {
+        for (int i = 0; i < MAX_NUMBERS_PER_DIRECTORY; i++) {
+            char code[MAX_CODE_LENGTH];
+            char number[MAX_PHONE_LENGTH];
+            snprintf(code, MAX_CODE_LENGTH, "contact%d", i);
+            snprintf(number, MAX_PHONE_LENGTH, "555-%03d-%04d", d, i);
+            addNumber(manager.directories[d].name, code, number);
         }
     }
-    manager.initialized = false;
-    printf("SpeedDialManager memory freed.\n");
+
+    CallerIdRecord *records = (CallerIdRecord *)malloc(batchSize * sizeof(CallerIdRecord));
+    if (records == NULL) {
+        perror("Failed to allocate benchmark data");
+        freeSpeedDialManager();
+        return EXIT_FAILURE;
+    }
+    uint64_t seed = 88172645463325252ull;
+    for (size_t i = 0; i < batchSize; i++) {
+        // Half the calls come from numbers in the directories
+        records[i].callingNumber = 5550000000ull + (nextRandom(&seed) % (MAX_DIRECTORIES * 2)) * 10000 +
+                                   nextRandom(&seed) % MAX_NUMBERS_PER_DIRECTORY;
+    }
+
+    printf("enrich: %zu calling numbers against %d entries\n", batchSize, TOTAL_NUMBERS);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int threads = 1; threads <= MAX_JOIN_THREADS && threads <= (cpus > 0 ? cpus : 1); threads *= 2) {
+        uint64_t start = nowNanoseconds();
+        size_t matched = enrichCallerIds(records, batchSize, threads);
+        uint64_t elapsed = nowNanoseconds() - start;
+        printf("  %2d thread(s): %.1f M records/s (%zu matched)\n",
+               threads, (double)batchSize * 1e3 / (double)elapsed, matched);
+    }
+
+    free(records);
+    freeSpeedDialManager();
+    manager.quiet = false;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Compares radix sorting of speed dial codes against qsort.
+ */
+static int benchmarkRadixSort(size_t count) {
+    const size_t stride = 16;
+    char *text = (char *)malloc(count * stride);
+    const char **byRadix = (const char **)malloc(count * sizeof(char *));
+    const char **byQsort = (const char **)malloc(count * sizeof(char *));
+    if (text == NULL || byRadix == NULL || byQsort == NULL) {
+        perror("Failed to allocate benchmark data");
+        free(text);
+        free(byRadix);
+        free(byQsort);
+        return EXIT_FAILURE;
+    }
+    static const char *const stems[] = {"contact", "home", "work", "mom", "office", "friend", "x"};
+    uint64_t seed = 88172645463325252ull;
+    for (size_t i = 0; i < count; i++) {
+        char *code = text + i * stride;
+        snprintf(code, stride, "%s%u", stems[nextRandom(&seed) % 7], (unsigned)(nextRandom(&seed) % 100000000));
+        byQsort[i] = code;
+    }
+
+    printf("radix: %zu codes\n", count);
+    uint64_t start = nowNanoseconds();
+    qsort(byQsort, count, sizeof(char *), compareStringPointers);
+    printf("  qsort          : %.0f ms\n", (double)(nowNanoseconds() - start) / 1e6);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int status = EXIT_SUCCESS;
+    for (int threads = 1; threads <= MAX_SORT_THREADS && threads <= (cpus > 0 ? cpus : 1); threads *= 2) {
+        for (size_t i = 0; i < count; i++) {
+            byRadix[i] = text + i * stride;
+        }
+        start = nowNanoseconds();
+        radixSortStrings(byRadix, count, threads);
+        printf("  radix %2d thread(s): %.0f ms\n", threads, (double)(nowNanoseconds() - start) / 1e6);
+        for (size_t i = 0; i < count; i++) {
+            if (strcmp(byRadix[i], byQsort[i]) != 0) {
+                printf("Error: radix sort order differs from qsort at %zu.\n", i);
+                status = EXIT_FAILURE;
+                break;
+            }
+        }
+    }
+
+    free(text);
+    free(byRadix);
+    free(byQsort);
+    return status;
+}
+
+/**
+ * @brief Compares lookup cache misses after a cold start with and without warming.
+ * A synthetic call log gives each hour of the day its own set of popular codes;
+ * then, for each hour, the cache is emptied and that hour's traffic replayed.
+ */
+static int benchmarkCacheWarming(size_t lookupsPerHour) {
+    manager.quiet = true;
+    initializeSpeedDialManager();
+    for (int d = 0; d < MAX_DIRECTORIES; d++) {
+        for (int i = 0; i < MAX_NUMBERS_PER_DIRECTORY; i++) {
+            char code[MAX_CODE_LENGTH];
+            char number[MAX_PHONE_LENGTH];
+            snprintf(code, MAX_CODE_LENGTH, "contact%d", i);
+            snprintf(number, MAX_PHONE_LENGTH, "555-%03d-%04d", d, i);
+            addNumber(manager.directories[d].name, code, number);
+        }
+    }
+
+    // Hour h favours a window of 40 entries starting at h * 40 (skewed within the window)
+    const int hotPerHour = 40;
+    uint64_t seed = 88172645463325252ull;
+    closeCallLog();
+    struct tm midnight;
+    time_t now = time(NULL);
+    localtime_r(&now, &midnight);
+    midnight.tm_hour = midnight.tm_min = midnight.tm_sec = 0;
+    time_t dayStart = mktime(&midnight);
+    callLog.header->baseTime = (int64_t)dayStart;
+    for (int call = 0; call < CALL_LOG_CAPACITY; call++) {
+        int hour = call % HOURS_PER_DAY;
+        int pick = (hour * hotPerHour + (int)(nextRandom(&seed) % hotPerHour) * (int)(nextRandom(&seed) % 2)) % TOTAL_NUMBERS;
+        const Directory *dir = &manager.directories[pick / MAX_NUMBERS_PER_DIRECTORY];
+        recordCallAt(dir->entries[pick % MAX_NUMBERS_PER_DIRECTORY].id, CALL_DIALED, dayStart + hour * 3600 + call % 3600);
+    }
+    learnDialPatterns();
+
+    uint64_t coldMisses[2] = {0, 0};
+    for (int warm = 0; warm <= 1; warm++) {
+        for (int hour = 0; hour < HOURS_PER_DAY; hour++) {
+            resetLookupCache();
+            if (warm) {
+                warmLookupCache(hour);
+            }
+            for (size_t i = 0; i < lookupsPerHour; i++) {
+                int pick = (hour * hotPerHour + (int)(nextRandom(&seed) % hotPerHour) * (int)(nextRandom(&seed) % 2)) % TOTAL_NUMBERS;
+                char code[MAX_CODE_LENGTH];
+                snprintf(code, MAX_CODE_LENGTH, "contact%d", pick % MAX_NUMBERS_PER_DIRECTORY);
+                getPhoneNumber(manager.directories[pick / MAX_NUMBERS_PER_DIRECTORY].name, code);
+            }
+            uint64_t hits, misses;
+            getLookupCacheStats(&hits, &misses);
+            coldMisses[warm] += misses;
+        }
+    }
+
+    double lookups = (double)lookupsPerHour * HOURS_PER_DAY;
+    printf("warming: %zu lookups per hour after a cold start, %d cache slots\n", lookupsPerHour, LOOKUP_CACHE_SIZE);
+    printf("  miss rate without warming: %.1f%%\n", 100.0 * (double)coldMisses[0] / lookups);
+    printf("  miss rate with warming   : %.1f%%\n", 100.0 * (double)coldMisses[1] / lookups);
+
+    closeCallLog();
+    freeSpeedDialManager();
+    manager.quiet = false;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Prints the footprint of this build configuration and its lookup and dial latency
+ * with every directory full.
+ */
+static int benchmarkFootprint(size_t lookups) {
+    manager.quiet = true;
+    initializeSpeedDialManager();
+    for (int d = 0; d < MAX_DIRECTORIES; d++) {
+        for (int i = 0; i < MAX_NUMBERS_PER_DIRECTORY; i++) {
+            char code[MAX_CODE_LENGTH];
+            char number[MAX_PHONE_LENGTH];
+            snprintf(code, MAX_CODE_LENGTH, "contact%d", i);
+            snprintf(number, MAX_PHONE_LENGTH, "555-%03d-%04d", d, i);
+            addNumber(manager.directories[d].name, code, number);
+        }
+    }
+    printFootprintReport();
+    printDirectoryMemoryReport();
+
+    uint64_t seed = 88172645463325252ull;
+    uint64_t elapsed[2] = {0, 0};
+    for (int dial = 0; dial <= 1; dial++) {
+        for (size_t i = 0; i < lookups; i++) {
+            uint64_t pick = nextRandom(&seed);
+            char code[MAX_CODE_LENGTH];
+            snprintf(code, MAX_CODE_LENGTH, "contact%d", (int)((pick >> 8) % MAX_NUMBERS_PER_DIRECTORY));
+            const char *directoryName = manager.directories[pick % MAX_DIRECTORIES].name;
+            uint64_t start = nowNanoseconds();
+            if (dial) {
+                dialSpeedDial(directoryName, code);
+            } else {
+                getPhoneNumber(directoryName, code);
+            }
+            elapsed[dial] += nowNanoseconds() - start;
+        }
+    }
+    printf("  lookup latency: %.0f ns mean, dial latency: %.0f ns mean (%zu each)\n",
+           (double)elapsed[0] / (double)lookups, (double)elapsed[1] / (double)lookups, lookups);
+
+    freeSpeedDialManager();
+    manager.quiet = false;
+    return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Keeps one server connection busy with listings and edits until told to stop.
+ */
+typedef struct {
+    const char *socketPath;
+    int worker;
+    _Atomic bool *stop;
+    uint64_t requests;
+} BackgroundLoad;
+
+static void *backgroundLoadWorker(void *arg) {
+    BackgroundLoad *load = (BackgroundLoad *)arg;
+    SpeedDialClient *client = (SpeedDialClient *)malloc(sizeof(SpeedDialClient));
+    if (client == NULL || !connectSpeedDialClient(client, load->socketPath)) {
+        free(client);
+        return NULL;
+    }
+    char line[SERVER_LINE_LENGTH];
+    while (!atomic_load(load->stop)) {
+        sendLine(client->fd, "LIST\tDirectory %d", 1 + load->worker % 4);
+        sendLine(client->fd, "ADD\tDirectory 5\tload%d\t555-000-%04d", load->worker, load->worker);
+        sendLine(client->fd, "DEL\tDirectory 5\tload%d", load->worker);
+        // Every response ends with one line other than ENTRY, INV or FLUSH
+        for (int responses = 0; responses < 3 && clientReadLine(client, line, sizeof(line), true);) {
+            if (strncmp(line, "ENTRY\t", 6) != 0 && !clientApplyPush(client, line)) {
+                responses++;
+            }
+        }
+        load->requests += 3;
+    }
+    disconnectSpeedDialClient(client);
+    free(client);
+    return NULL;
+}
+
+static void *benchmarkServerThread(void *arg) {
+    runSpeedDialServer((const char *)arg);
+    return NULL;
+}
+
+/**
+ * @brief Measures round trips of a GET over its own connection, bypassing the client cache.
+ * Prints the median, 99th percentile and worst latency.
+ */
+static void measureServerDials(SpeedDialClient *client, const char *label, const char *directoryName,
+                               const char *speedDialCode, uint64_t *latencies, size_t dials) {
+    char line[SERVER_LINE_LENGTH];
+    for (size_t i = 0; i < dials; i++) {
+        uint64_t start = nowNanoseconds();
+        sendLine(client->fd, "GET\t%s\t%s", directoryName, speedDialCode);
+        while (clientReadLine(client, line, sizeof(line), true) && clientApplyPush(client, line)) {
+        }
+        latencies[i] = nowNanoseconds() - start;
+    }
+    qsort(latencies, dials, sizeof(uint64_t), compareUint64);
+    printf("  %-28s p50 %6.1f us  p99 %7.1f us  max %7.1f us\n", label, (double)latencies[dials / 2] / 1e3,
+           (double)latencies[dials * 99 / 100] / 1e3, (double)latencies[dials - 1] / 1e3);
+}
+
+/**
+ * @brief Compares emergency and ordinary dial latency through the lookup server,
+ * idle and while other connections flood it with listings and edits.
+ */
+static int benchmarkEmergencyDial(size_t dials) {
+    const char *socketPath = "/tmp/speeddial_bench.sock";
+    const int loadWorkers = 8;
+    manager.quiet = true;
+    initializeSpeedDialManager();
+    for (int d = 0; d < MAX_DIRECTORIES - 1; d++) {
+        for (int i = 0; i < MAX_NUMBERS_PER_DIRECTORY; i++) {
+            char code[MAX_CODE_LENGTH];
+            char number[MAX_PHONE_LENGTH];
+            snprintf(code, MAX_CODE_LENGTH, "contact%d", i);
+            snprintf(number, MAX_PHONE_LENGTH, "555-%03d-%04d", d, i);
+            addNumber(manager.directories[d].name, code, number);
+        }
+    }
+    addNumber("Directory 5", "emergency", "911");
+    flagEmergencyEntry("Directory 5", "emergency");
+
+    uint64_t *latencies = (uint64_t *)malloc(dials * sizeof(uint64_t));
+    SpeedDialClient *client = (SpeedDialClient *)malloc(sizeof(SpeedDialClient));
+    pthread_t server;
+    if (latencies == NULL || client == NULL ||
+        pthread_create(&server, NULL, benchmarkServerThread, (void *)socketPath) != 0) {
+        perror("Failed to start emergency benchmark");
+        free(latencies);
+        free(client);
+        freeSpeedDialManager();
+        return EXIT_FAILURE;
+    }
+    bool connected = false;
+    for (int attempt = 0; attempt < 100 && !connected; attempt++) {
+        usleep(10000); // Until the server is listening
+        connected = connectSpeedDialClient(client, socketPath);
+    }
+
+    int status = EXIT_FAILURE;
+    if (connected) {
+        printf("emergency: %zu dials per measurement, %d background connections\n", dials, loadWorkers);
+        measureServerDials(client, "emergency, idle", "Directory 5", "emergency", latencies, dials);
+
+        _Atomic bool stop = false;
+        BackgroundLoad loads[8];
+        pthread_t workers[8];
+        for (int w = 0; w < loadWorkers; w++) {
+            loads[w] = (BackgroundLoad){socketPath, w, &stop, 0};
+            pthread_create(&workers[w], NULL, backgroundLoadWorker, &loads[w]);
+        }
+        usleep(100000); // Let the load build up
+        uint64_t start = nowNanoseconds();
+        measureServerDials(client, "emergency, under load", "Directory 5", "emergency", latencies, dials);
+        char ordinaryCode[MAX_CODE_LENGTH];
+        snprintf(ordinaryCode, MAX_CODE_LENGTH, "contact%d", MAX_NUMBERS_PER_DIRECTORY - 1); // Assigned, last in its directory
+        measureServerDials(client, "ordinary dial, under load", "Directory 2", ordinaryCode, latencies, dials);
+        double seconds = (double)(nowNanoseconds() - start) / 1e9;
+        atomic_store(&stop, true);
+        uint64_t background = 0;
+        for (int w = 0; w < loadWorkers; w++) {
+            pthread_join(workers[w], NULL);
+            background += loads[w].requests;
+        }
+        printf("  background: %.0f requests/s, %llu bulk and %llu edit requests shed\n", (double)background / seconds,
+               (unsigned long long)atomic_load(&rejectedRequests[REQUEST_BULK]),
+               (unsigned long long)atomic_load(&rejectedRequests[REQUEST_EDIT]));
+        disconnectSpeedDialClient(client);
+        status = EXIT_SUCCESS;
+    }
+
+    stopSpeedDialServer();
+    pthread_join(server, NULL);
+    free(latencies);
+    free(client);
+    freeSpeedDialManager();
+    manager.quiet = false;
+    return status;
+}
+
+/**
+ * @brief Asks for rate-limited requests as fast as a thread can until told to stop.
+ */
+typedef struct {
+    uint64_t deadline; // nowNanoseconds() at which to stop
+    uint64_t admitted;
+} RateLimitCaller;
+
+static void *rateLimitCallerThread(void *arg) {
+    RateLimitCaller *caller = (RateLimitCaller *)arg;
+    while (nowNanoseconds() < caller->deadline) {
+        caller->admitted += admitRequest(0, REQUEST_DIAL);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Checks that a tenant gets its configured rate, no more and no less, whether
+ * one thread or several ask for it.
+ * @return EXIT_SUCCESS if every run admitted within 5% of rate * seconds + burst.
+ */
+static int benchmarkRateLimit(size_t seconds) {
+    const double perSecond = 1000;
+    const double burst = 100;
+    manager.quiet = true;
+    initializeSpeedDialManager();
+    double expected = perSecond * (double)seconds + burst;
+    printf("rate limit: %.0f/s with a burst of %.0f for %zu s (expect about %.0f admitted)\n", perSecond, burst,
+           seconds, expected);
+
+    int status = EXIT_SUCCESS;
+    const int threadCounts[] = {1, 4};
+    for (int run = 0; run < 2; run++) {
+        setRateLimit("Directory 1", REQUEST_DIAL, perSecond, burst);
+        RateLimitCaller callers[4];
+        pthread_t threads[4];
+        uint64_t deadline = nowNanoseconds() + (uint64_t)seconds * 1000000000ull;
+        for (int t = 0; t < threadCounts[run]; t++) {
+            callers[t] = (RateLimitCaller){deadline, 0};
+            pthread_create(&threads[t], NULL, rateLimitCallerThread, &callers[t]);
+        }
+        uint64_t admitted = 0;
+        for (int t = 0; t < threadCounts[run]; t++) {
+            pthread_join(threads[t], NULL);
+            admitted += callers[t].admitted;
+        }
+        bool ok = (double)admitted > expected * 0.95 && (double)admitted < expected * 1.05;
+        printf("  %d thread(s): %llu admitted (%s)\n", threadCounts[run], (unsigned long long)admitted,
+               ok ? "PASS" : "FAIL");
+        status |= ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    setRateLimit("Directory 1", REQUEST_DIAL, 0, 1);
+    freeSpeedDialManager();
+    manager.quiet = false;
+    return status;
+}
+
+/**
+ * @brief Runs the benchmark named by argv[0] ("portability", "enrich", "radix", "warming", "emergency", "footprint",
+ * "ratelimit"), or all of them.
+ *
+ * @param argc The number of benchmark arguments.
+ * @param argv The benchmark name followed by an optional size.
+ * @return EXIT_SUCCESS if every benchmark ran; EXIT_FAILURE otherwise.
+ */
+int runBenchmarks(int argc, char **argv) {
+    const char *name = argc > 0 ? argv[0] : "all";
+    size_t size = argc > 1 ? strtoull(argv[1], NULL, 10) : 0;
+    bool all = strcmp(name, "all") == 0;
+    bool ran = false;
+    int status = EXIT_SUCCESS;
+
+    if (all || strcmp(name, "portability") == 0) {
+        status |= benchmarkPortability(size ? size : 10000000);
+        ran = true;
+    }
+    if (all || strcmp(name, "enrich") == 0) {
+        status |= benchmarkEnrichment(size ? size : 10000000);
+        ran = true;
+    }
+    if (all || strcmp(name, "radix") == 0) {
+        status |= benchmarkRadixSort(size ? size : 10000000);
+        ran = true;
+    }
+    if (all || strcmp(name, "warming") == 0) {
+        status |= benchmarkCacheWarming(size ? size : 100);
+        ran = true;
+    }
+    if (all || strcmp(name, "emergency") == 0) {
+        status |= benchmarkEmergencyDial(size ? size : 20000);
+        ran = true;
+    }
+    if (all || strcmp(name, "footprint") == 0) {
+        status |= benchmarkFootprint(size ? size : 1000000);
+        ran = true;
+    }
+    if (all || strcmp(name, "ratelimit") == 0) {
+        status |= benchmarkRateLimit(size ? size : 1);
+        ran = true;
+    }
+
+    if (!ran) {
+        printf("Unknown benchmark '%s'.\n", name);
+        return EXIT_FAILURE;
+    }
+    return status;
+}
+
+#ifdef SPEEDDIAL_RT_HARNESS
+// Real-time harness: build with -DSPEEDDIAL_RT_HARNESS to replace the allocator with
+// one that counts calls while the harness is measuring, then run "rt [iterations]".
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+static _Atomic bool harnessArmed;
+static _Atomic uint64_t harnessAllocations;
+
+void *malloc(size_t size) {
+    if (atomic_load_explicit(&harnessArmed, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&harnessAllocations, 1, memory_order_relaxed);
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    if (atomic_load_explicit(&harnessArmed, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&harnessAllocations, 1, memory_order_relaxed);
+    }
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    if (atomic_load_explicit(&harnessArmed, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&harnessAllocations, 1, memory_order_relaxed);
+    }
+    return __libc_realloc(pointer, size);
+}
+
+/**
+ * @brief Measures worst-case getPhoneNumber() and dialSpeedDial() latency in real-time
+ * mode over a mix of hits, misses, unknown directories and emergency dials.
+ * @return EXIT_FAILURE if any call allocated, or real-time mode could not be entered.
+ */
+static int runRealTimeHarness(size_t iterations) {
+    static char codes[MAX_NUMBERS_PER_DIRECTORY + 1][MAX_CODE_LENGTH];
+    manager.quiet = true;
+    initializeSpeedDialManager();
+    for (int i = 0; i <= MAX_NUMBERS_PER_DIRECTORY; i++) {
+        snprintf(codes[i], MAX_CODE_LENGTH, "contact%d", i); // The last code is never added
+    }
+    for (int d = 0; d < MAX_DIRECTORIES - 1; d++) {
+        for (int i = 0; i < MAX_NUMBERS_PER_DIRECTORY; i++) {
+            char number[MAX_PHONE_LENGTH];
+            snprintf(number, MAX_PHONE_LENGTH, "555-%03d-%04d", d, i);
+            addNumber(manager.directories[d].name, codes[i], number);
+        }
+    }
+    addNumber("Directory 5", "emergency", "911");
+    flagEmergencyEntry("Directory 5", "emergency");
+    manager.quiet = false; // Real-time mode alone must keep the paths silent
+    if (!enterRealTimeMode()) {
+        freeSpeedDialManager();
+        return EXIT_FAILURE;
+    }
+
+    const char *operations[] = {"lookup", "dial", "emergency dial", "miss"};
+    uint64_t worst[4] = {0, 0, 0, 0};
+    uint64_t total[4] = {0, 0, 0, 0};
+    uint64_t seed = 88172645463325252ull;
+    atomic_store(&harnessArmed, true);
+    for (size_t i = 0; i < iterations; i++) {
+        int operation = (int)(i & 3);
+        uint64_t pick = nextRandom(&seed);
+        const char *directoryName = manager.directories[pick % (MAX_DIRECTORIES - 1)].name;
+        const char *code = codes[(pick >> 8) % MAX_NUMBERS_PER_DIRECTORY];
+        uint64_t start = nowNanoseconds();
+        switch (operation) {
+        case 0: getPhoneNumber(directoryName, code); break;
+        case 1: dialSpeedDial(directoryName, code); break;
+        case 2: dialSpeedDial("Directory 5", "emergency"); break;
+        default: getPhoneNumber((pick & 256) ? "Directory 9" : directoryName, codes[MAX_NUMBERS_PER_DIRECTORY]); break;
+        }
+        uint64_t elapsed = nowNanoseconds() - start;
+        total[operation] += elapsed;
+        if (elapsed > worst[operation]) {
+            worst[operation] = elapsed;
+        }
+    }
+    atomic_store(&harnessArmed, false);
+    leaveRealTimeMode();
+
+    uint64_t allocations = atomic_load(&harnessAllocations);
+    printf("rt: %zu calls in real-time mode\n", iterations);
+    for (int operation = 0; operation < 4; operation++) {
+        printf("  %-15s mean %7.0f ns  worst %9.0f ns\n", operations[operation],
+               (double)total[operation] / (double)(iterations / 4 + 1), (double)worst[operation]);
+    }
+    printf("  heap allocations: %llu (%s)\n", (unsigned long long)allocations, allocations == 0 ? "PASS" : "FAIL");
+    manager.quiet = true;
+    freeSpeedDialManager();
+    manager.quiet = false;
+    return allocations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
 // --- Main Function (Demonstration) ---
-int main() {
+int main(int argc, char **argv) {
+    // "bench [name] [size]" runs the benchmark suite instead of the demonstration
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return runBenchmarks(argc - 2, argv + 2);
+    }
+#ifdef SPEEDDIAL_RT_HARNESS
+    // "rt [iterations]" checks the dial path for allocations and reports worst-case latency
+    if (argc > 1 && strcmp(argv[1], "rt") == 0) {
+        return runRealTimeHarness(argc > 2 ? strtoull(argv[2], NULL, 10) : 4000000);
+    }
+#endif
+    // "serve <socket>" runs the lookup server on a local socket
+    // "serve <socket> <trace>" also records every operation the server performs
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "serve") == 0) {
+        manager.quiet = true;
+        initializeSpeedDialManager();
+        if (argc == 4 && !startTrace(argv[3])) {
+            return EXIT_FAILURE;
+        }
+        // SPEEDDIAL_METRICS_PORT=<port> serves Prometheus metrics on 127.0.0.1:<port>
+        const char *metricsPort = getenv("SPEEDDIAL_METRICS_PORT");
+        if (metricsPort != NULL && !listenForMetrics(atoi(metricsPort))) {
+            return EXIT_FAILURE;
+        }
+        int status = runSpeedDialServer(argv[2]);
+        stopTrace();
+        freeSpeedDialManager();
+        return status;
+    }
+    // "replay <trace> [speed]" drives a fresh manager with a recorded trace (speed 0: flat out)
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "replay") == 0) {
+        return replayTrace(argv[2], argc == 4 ? strtod(argv[3], NULL) : 0);
+    }
+    // "client <socket> <directory> <code>" looks a code up twice through the client cache
+    if (argc == 5 && strcmp(argv[1], "client") == 0) {
+        SpeedDialClient client;
+        if (!connectSpeedDialClient(&client, argv[2])) {
+            return EXIT_FAILURE;
+        }
+        for (int i = 0; i < 2; i++) {
+            const char *phoneNumber = clientGetPhoneNumber(&client, argv[3], argv[4]);
+            printf("%s (cache %s)\n", phoneNumber != NULL ? phoneNumber : "not found", client.hits > 0 ? "hit" : "miss");
+        }
+        disconnectSpeedDialClient(&client);
+        return EXIT_SUCCESS;
+    }
+
     printf("--- Starting C Speed Dial System Demonstration ---\n");
 
     // 1. Initialize the SpeedDialManager
@@ -325,6 +5716,9 @@ int main() {
     // 2. List all initial directories
     listAllDirectoryNames();
 
+    // 2b. Follow every change from here on, as a downstream cache or search index would
+    ChangeCursor follower = subscribeChanges(false);
+
     // 3. Add some sample numbers to different directories
     printf("\n--- Adding sample numbers ---\n");
     addNumber("Directory 1", "home", "123-456-7890");
@@ -362,6 +5756,62 @@ int main() {
     const char *nonExistentNumber = getPhoneNumber("Directory 1", "dad"); // Not found
     const char *nonExistentDirNumber = getPhoneNumber("Directory 7", "any"); // Directory not found
 
+    // 6b. Resolve the carrier of a ported number after retrieving it
+    printf("\n--- Retrieving numbers with number portability ---\n");
+    uint64_t portedRecords[] = {
+        (packPhoneNumber("555-111-2222") << PORTABILITY_CARRIER_BITS) | 42,
+        (packPhoneNumber("111-222-3333") << PORTABILITY_CARRIER_BITS) | 7,
+    };
+    if (writePortabilityDb("/tmp/speeddial_demo_portability.bin", portedRecords, 2) &&
+        openPortabilityDb("/tmp/speeddial_demo_portability.bin")) {
+        unsigned carrier;
+        getPhoneNumberWithCarrier("Directory 1", "mom", &carrier);
+        getPhoneNumberWithCarrier("Directory 1", "home", &carrier); // Not ported
+        closePortabilityDb();
+        unlink("/tmp/speeddial_demo_portability.bin");
+    }
+
+    // 6c. Tag a small CDR batch with the directory entries that own the calling numbers
+    printf("\n--- Enriching caller IDs ---\n");
+    CallerIdRecord cdrs[] = {
+        {packPhoneNumber("444-555-6666"), INVALID_ENTRY_ID},
+        {packPhoneNumber("222-333-4444"), INVALID_ENTRY_ID},
+        {packPhoneNumber("911"), INVALID_ENTRY_ID},
+    };
+    size_t enriched = enrichCallerIds(cdrs, 3, 1);
+    for (int i = 0; i < 3; i++) {
+        int ownerDirectory;
+        const SpeedDialEntry *owner = getEntryById(cdrs[i].owner, &ownerDirectory);
+        if (owner != NULL) {
+            printf("  %llu -> '%s' in '%s'\n", (unsigned long long)cdrs[i].callingNumber,
+                   owner->speedDialCode, manager.directories[ownerDirectory].name);
+        } else {
+            printf("  %llu -> unknown caller\n", (unsigned long long)cdrs[i].callingNumber);
+        }
+    }
+    printf("  %zu of 3 calls matched.\n", enriched);
+
+    // 6d. Compare two directories
+    addNumber("Directory 2", "home", "123-456-7890");
+    printf("\n--- Codes in 'Directory 1' that are not in 'Directory 2' ---\n");
+    DirectorySetIterator setIterator;
+    if (beginDirectorySetOperation(&setIterator, "Directory 1", "Directory 2", SET_DIFFERENCE, SET_KEY_CODE)) {
+        for (const SpeedDialEntry *entry; (entry = nextSetResult(&setIterator)) != NULL;) {
+            printf("  %s: %s\n", entry->speedDialCode, entry->phoneNumber);
+        }
+    }
+
+    // 6e. Ad-hoc query: numbers starting with "555" across all directories
+    printf("\n--- Scanning for numbers starting with '555' in Directories 1-5 ---\n");
+    ScanPredicate startsWith555 = {SCAN_NUMBER_PREFIX, "555", 0};
+    EntryId scanMatches[8];
+    size_t scanned = scanEntries(&startsWith555, 1, 0, MAX_DIRECTORIES - 1, scanMatches, 8, 2);
+    for (size_t i = 0; i < scanned && i < 8; i++) {
+        int matchDirectory;
+        const SpeedDialEntry *entry = getEntryById(scanMatches[i], &matchDirectory);
+        printf("  %s: %s (%s)\n", entry->speedDialCode, entry->phoneNumber, manager.directories[matchDirectory].name);
+    }
+
     // 7. List numbers in specific directories
     listNumbersInDirectory("Directory 1");
     listNumbersInDirectory("Directory 2");
@@ -369,12 +5819,77 @@ int main() {
 
     // 8. Remove numbers
     printf("\n--- Removing numbers ---\n");
+    EntryId workId = getEntryId("Directory 1", "work");
+    EntryId momId = getEntryId("Directory 1", "mom");
     removeNumber("Directory 1", "work"); // Successful removal
+    // The removed entry's id is now stale, while "mom" keeps its id even though it moved
+    printf("  'work' id %s, 'mom' id resolves to '%s'\n",
+           getEntryById(workId, NULL) == NULL ? "is stale" : "still resolves",
+           getEntryById(momId, NULL)->phoneNumber);
     removeNumber("Directory 2", "nonexistent"); // Try removing a non-existent entry
+
+    // Purge several codes at once; the directory is compacted in one pass
+    const char *purged[] = {"contact1", "contact2", "contact3", "not-there"};
+    removeNumbersBatch("Directory 3", purged, 4);
+
+    // 8a. Change numbers in place: the entry keeps its id, so "mom" still resolves
+    updateNumber("Directory 1", "mom", "555-111-9999");
+    updateNumber("Directory 1", "dad", "555-000-0000"); // Not in the directory
+    upsertNumber("Directory 1", "dad", "555-000-0000"); // Added instead
+    printf("  'mom' id now resolves to '%s'\n", getEntryById(momId, NULL)->phoneNumber);
+    // Two admin tools read version 2 of 'mom'; the second one to write loses
+    uint32_t momVersion = getEntryVersion("Directory 1", "mom");
+    casNumber("Directory 1", "mom", momVersion, "555-111-0000");
+    casNumber("Directory 1", "mom", momVersion, "555-111-7777"); // Conflict: 'mom' is now at version 3
+    // Move and swap entries between directories; each commits as one transaction
+    EntryId friendId = getEntryId("Directory 2", "friend2");
+    moveNumber("Directory 2", "Directory 4", "friend2");
+    moveNumber("Directory 1", "Directory 2", "home"); // Directory 2 has its own 'home'
+    swapNumbers("Directory 1", "home", "Directory 2", "home");
+    printf("  'friend2' id now resolves to '%s' in Directory 4; Directory 1 'home' is '%s'\n",
+           getEntryById(friendId, NULL)->phoneNumber, getPhoneNumber("Directory 1", "home"));
     removeNumber("Directory 6", "any"); // Try removing from a non-existent directory
 
+    // 8b. Dial a few codes; each call lands in the call log
+    printf("\n--- Dialing and call history ---\n");
+    dialSpeedDial("Directory 1", "mom");
+    dialSpeedDial("Directory 1", "home");
+    dialSpeedDial("Directory 1", "mom");
+    dialSpeedDial("Directory 1", "work"); // Removed above
+    flagEmergencyEntry("Directory 5", "emergency");
+    dialSpeedDial("Directory 5", "emergency"); // Pinned fast path
+    CallLogEntry recentCalls[5];
+    int recentCount = getRecentCalls("Directory 1", "mom", recentCalls, 5);
+    printf("  'mom' was dialed %d time(s) recently.\n", recentCount);
+
+    // 8c. Catch the follower up in batches
+    printf("\n--- Change feed ---\n");
+    ChangeEvent changes[64];
+    int changeTotal = 0;
+    for (int batch; (batch = readChanges(&follower, changes, 64)) > 0;) {
+        for (int i = 0; i < batch; i++) {
+            if (changes[i].type == CHANGE_REMOVE) {
+                printf("  #%llu removed '%s' from '%s'\n", (unsigned long long)changes[i].sequence,
+                       changes[i].speedDialCode, manager.directories[changes[i].directoryIndex].name);
+            } else if (changes[i].type == CHANGE_UPDATE) {
+                printf("  #%llu changed '%s' in '%s' to %s\n", (unsigned long long)changes[i].sequence,
+                       changes[i].speedDialCode, manager.directories[changes[i].directoryIndex].name,
+                       changes[i].phoneNumber);
+            }
+        }
+        changeTotal += batch;
+    }
+    printf("  Follower caught up after %d changes.\n", changeTotal);
+
     // 9. List numbers after removal
     listNumbersInDirectory("Directory 1");
+    listNumbersInDirectorySorted("Directory 1");
+
+    // 9b. Capacity statistics, maintained as numbers are added and removed
+    setDirectoryQuota("Directory 1", 10);
+    printCapacityReport();
+    printf("  Numbers starting with 555 in 'Directory 1': %d\n", getPrefixCount("555", "Directory 1"));
+    printDirectoryMemoryReport();
 
     // 10. Free allocated memory
     freeSpeedDialManager();